@@ -0,0 +1,669 @@
+// Benchmarks for PolymurHash. Build with optimizations, for example
+//
+//     cc -O2 -pthread bench.c -o polymur-bench
+//
+// and run ./polymur-bench [--json] [name] to only run the named benchmark.
+// With --json the length, size and mix benchmarks write their results as a
+// single JSON object to stdout, for tracking regressions between builds.
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#if defined(__linux__)
+    #include <sys/syscall.h>
+    #include <linux/perf_event.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+#include "polymur-hash.h"
+#include "polymur-columnar.h"
+#include "polymur-cdc.h"
+#include "polymur-sketch.h"
+
+static double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Prevents the compiler from optimizing away benchmarked computations.
+static volatile uint64_t bench_sink;
+
+// Always zero, but unknown to the compiler. Adding h & zero to an input
+// pointer makes the next hash depend on the previous one without moving it.
+static volatile uint64_t bench_zero;
+
+static void* bench_alloc(size_t size) {
+    void* p = malloc(size);
+    if (!p) {
+        fprintf(stderr, "out of memory allocating %zu bytes\n", size);
+        exit(1);
+    }
+    memset(p, 0x5a, size);
+    return p;
+}
+
+
+// ---------- Cycle counting ----------
+// Core cycles from perf counters where the kernel allows it, else the
+// timestamp counter (which ticks at a fixed reference frequency, so it only
+// equals core cycles with frequency scaling off), else nanoseconds.
+static int bench_perf_fd = -1;
+static const char* bench_counter = "ns";
+static const char* bench_unit = "ns";
+
+static void bench_init_counter(void) {
+#if defined(__linux__)
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    bench_perf_fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (bench_perf_fd >= 0) {
+        bench_counter = "perf";
+        bench_unit = "cycles";
+        return;
+    }
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+    bench_counter = "rdtsc";
+    bench_unit = "cycles";
+#endif
+}
+
+static uint64_t bench_ticks(void) {
+#if defined(__linux__)
+    if (bench_perf_fd >= 0) {
+        uint64_t v = 0;
+        if (read(bench_perf_fd, &v, sizeof(v)) == sizeof(v)) return v;
+    }
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t) (bench_now() * 1e9);
+#endif
+}
+
+
+// ---------- Output ----------
+static int bench_json;
+static int bench_json_records;
+
+// Writes a JSON result record, fmt gives the fields without braces.
+static void bench_record(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    printf("%s\n    {", bench_json_records++ ? "," : "");
+    vprintf(fmt, args);
+    printf("}");
+    va_end(args);
+}
+
+
+// ---------- Seeding ----------
+#define BENCH_SEEDS 100000
+
+static void bench_seed(void) {
+    static PolymurHashParams params[BENCH_SEEDS];
+    double best[3] = {1e100, 1e100, 1e100};
+    for (int round = 0; round < 5; ++round) {
+        double t0 = bench_now();
+        for (size_t i = 0; i < BENCH_SEEDS; ++i) polymur_init_params_from_seed(&params[i], i);
+        double t1 = bench_now();
+        for (size_t i = 0; i < BENCH_SEEDS; ++i) {
+            polymur_init_params_fast(&params[i], polymur_mix(i + POLYMUR_ARBITRARY3), polymur_mix(i + POLYMUR_ARBITRARY4));
+        }
+        double t2 = bench_now();
+        polymur_init_params_many(params, BENCH_SEEDS, 0);
+        double t3 = bench_now();
+        if (t1 - t0 < best[0]) best[0] = t1 - t0;
+        if (t2 - t1 < best[1]) best[1] = t2 - t1;
+        if (t3 - t2 < best[2]) best[2] = t3 - t2;
+        bench_sink += params[round].k;
+    }
+    printf("seed: ns per seed\n");
+    printf("  polymur_init_params      %7.1f\n", best[0] / BENCH_SEEDS * 1e9);
+    printf("  polymur_init_params_fast %7.1f\n", best[1] / BENCH_SEEDS * 1e9);
+    printf("  polymur_init_params_many %7.1f\n", best[2] / BENCH_SEEDS * 1e9);
+}
+
+
+// ---------- Per-length latency and throughput ----------
+// Hashing at an offset of 1 from 64-byte alignment covers misaligned loads.
+#define BENCH_LENGTH_MAX 256
+#define BENCH_LENGTH_REPS 20000
+
+// Best time in ticks per hash of len bytes at buf. Latency chains every hash
+// into the next input pointer and tweak, throughput makes them independent.
+static double bench_hash_ticks(const uint8_t* buf, size_t len, const PolymurHashParams* p, size_t reps, int latency) {
+    const uint64_t zero = bench_zero;
+    double best = 1e100;
+    for (int round = 0; round < 7; ++round) {
+        uint64_t h = 0;
+        uint64_t t0 = bench_ticks();
+        if (latency) {
+            for (size_t r = 0; r < reps; ++r) h = polymur_hash(buf + (h & zero), len, p, h);
+        } else {
+            for (size_t r = 0; r < reps; ++r) h ^= polymur_hash(buf, len, p, r);
+        }
+        double t = (double) (bench_ticks() - t0) / reps;
+        if (t < best) best = t;
+        bench_sink += h;
+    }
+    return best;
+}
+
+static void bench_lengths(const PolymurHashParams* p) {
+    uint8_t* buf = (uint8_t*) bench_alloc(BENCH_LENGTH_MAX + 128);
+    uint8_t* aligned = buf + (64 - (uintptr_t) buf % 64) % 64;
+    if (!bench_json) printf("lengths: %s per hash, latency / throughput\n", bench_unit);
+    for (size_t len = 0; len <= BENCH_LENGTH_MAX; ++len) {
+        double r[2][2];
+        for (int align = 0; align < 2; ++align) {
+            for (int latency = 0; latency < 2; ++latency) {
+                r[align][latency] = bench_hash_ticks(aligned + align, len, p, BENCH_LENGTH_REPS, latency);
+            }
+            if (bench_json) {
+                bench_record("\"bench\": \"length\", \"len\": %zu, \"misalign\": %d, \"latency\": %.2f, \"throughput\": %.2f",
+                             len, align, r[align][1], r[align][0]);
+            }
+        }
+        if (!bench_json) {
+            printf("  %3zu bytes  aligned %6.1f / %6.1f  misaligned %6.1f / %6.1f\n",
+                   len, r[0][1], r[0][0], r[1][1], r[1][0]);
+        }
+    }
+    free(buf);
+}
+
+
+// ---------- Bulk throughput ----------
+static void bench_sizes(const PolymurHashParams* p, size_t max_mb) {
+    size_t max_size = max_mb << 20;
+    uint8_t* buf = (uint8_t*) bench_alloc(max_size + 128);
+    uint8_t* aligned = buf + (64 - (uintptr_t) buf % 64) % 64;
+    if (!bench_json) printf("sizes: bytes per %s and GB/s, aligned / misaligned\n", strcmp(bench_unit, "cycles") == 0 ? "cycle" : "ns");
+    for (size_t size = 512; size <= max_size; size *= 2) {
+        // At least 64 MiB per measurement, at least one full pass.
+        size_t reps = size < (64 << 20) ? (64 << 20) / size : 1;
+        double per_tick[2], gbps[2];
+        for (int align = 0; align < 2; ++align) {
+            double best_ticks = 1e100, best_time = 1e100;
+            for (int round = 0; round < 3; ++round) {
+                uint64_t h = 0;
+                double t0 = bench_now();
+                uint64_t c0 = bench_ticks();
+                for (size_t r = 0; r < reps; ++r) h ^= polymur_hash(aligned + align, size, p, r);
+                double ticks = (double) (bench_ticks() - c0);
+                double t = bench_now() - t0;
+                if (ticks < best_ticks) best_ticks = ticks;
+                if (t < best_time) best_time = t;
+                bench_sink += h;
+            }
+            per_tick[align] = (double) size * reps / best_ticks;
+            gbps[align] = (double) size * reps / best_time / 1e9;
+            if (bench_json) {
+                bench_record("\"bench\": \"size\", \"bytes\": %zu, \"misalign\": %d, \"bytes_per_tick\": %.3f, \"gbps\": %.3f",
+                             size, align, per_tick[align], gbps[align]);
+            }
+        }
+        if (!bench_json) {
+            printf("  %10zu bytes  %6.2f / %6.2f  %6.2f / %6.2f GB/s\n", size, per_tick[0], per_tick[1], gbps[0], gbps[1]);
+        }
+    }
+    free(buf);
+}
+
+
+// ---------- Random length mixes ----------
+// Random lengths in [min, max] at random offsets from a table too large for
+// the branch predictor to learn, so that mixes spanning several length
+// classes pay for mispredicted dispatch.
+#define BENCH_MIX_KEYS (1 << 16)
+
+static void bench_mixes(const PolymurHashParams* p) {
+    static const size_t ranges[][2] = {{0, 7}, {8, 21}, {22, 49}, {50, 64}, {0, 49}, {0, 64}, {0, 256}};
+    uint8_t* buf = (uint8_t*) bench_alloc(4096 + 256);
+    uint32_t* offsets = (uint32_t*) bench_alloc(BENCH_MIX_KEYS * sizeof(*offsets));
+    uint32_t* lens = (uint32_t*) bench_alloc(BENCH_MIX_KEYS * sizeof(*lens));
+    const uint64_t zero = bench_zero;
+    if (!bench_json) printf("mix: %s per hash of random length, latency / throughput\n", bench_unit);
+    for (size_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); ++i) {
+        size_t lo = ranges[i][0], hi = ranges[i][1];
+        for (size_t k = 0; k < BENCH_MIX_KEYS; ++k) {
+            lens[k] = (uint32_t) (lo + polymur_mix(k + 1000 * i) % (hi - lo + 1));
+            offsets[k] = (uint32_t) (polymur_mix(~k) % 4096);
+        }
+
+        double best[2] = {1e100, 1e100};
+        for (int round = 0; round < 7; ++round) {
+            uint64_t h = 0;
+            uint64_t t0 = bench_ticks();
+            for (size_t k = 0; k < BENCH_MIX_KEYS; ++k) h ^= polymur_hash(buf + offsets[k], lens[k], p, k);
+            uint64_t t1 = bench_ticks();
+            for (size_t k = 0; k < BENCH_MIX_KEYS; ++k) h = polymur_hash(buf + offsets[k] + (h & zero), lens[k], p, h);
+            uint64_t t2 = bench_ticks();
+            if ((double) (t1 - t0) < best[0]) best[0] = (double) (t1 - t0);
+            if ((double) (t2 - t1) < best[1]) best[1] = (double) (t2 - t1);
+            bench_sink += h;
+        }
+        if (bench_json) {
+            bench_record("\"bench\": \"mix\", \"min_len\": %zu, \"max_len\": %zu, \"latency\": %.2f, \"throughput\": %.2f",
+                         lo, hi, best[1] / BENCH_MIX_KEYS, best[0] / BENCH_MIX_KEYS);
+        } else {
+            printf("  %3zu..%-3zu bytes  %6.1f / %6.1f\n", lo, hi, best[1] / BENCH_MIX_KEYS, best[0] / BENCH_MIX_KEYS);
+        }
+    }
+    free(buf); free(offsets); free(lens);
+}
+
+
+// ---------- Batched hashing ----------
+#define BENCH_BATCH_KEYS (1 << 20)
+#define BENCH_BATCH_POOL (1 << 12) // Key bytes stay in cache.
+#define BENCH_BATCH_CHUNK 256
+#define BENCH_BATCH_BUCKETS (1 << 23)
+
+static void bench_batch(const PolymurHashParams* p) {
+    uint8_t* data = (uint8_t*) bench_alloc(BENCH_BATCH_POOL * 64ULL);
+    const uint8_t** keys = (const uint8_t**) bench_alloc(BENCH_BATCH_KEYS * sizeof(*keys));
+    size_t* lens = (size_t*) bench_alloc(BENCH_BATCH_KEYS * sizeof(*lens));
+    uint64_t* out = (uint64_t*) bench_alloc(BENCH_BATCH_KEYS * sizeof(*out));
+    uint64_t* buckets = (uint64_t*) bench_alloc(BENCH_BATCH_BUCKETS * sizeof(*buckets));
+    const uint64_t mask = BENCH_BATCH_BUCKETS - 1;
+    for (size_t i = 0; i < BENCH_BATCH_POOL * 64ULL; ++i) data[i] = (uint8_t) polymur_mix(i);
+    for (size_t i = 0; i < BENCH_BATCH_KEYS; ++i) {
+        keys[i] = data + 64 * (i % BENCH_BATCH_POOL);
+        lens[i] = polymur_mix(i ^ 0xabcdef) % 65;
+    }
+
+    printf("batch: %d keys of random length 0..64, Mkeys/s\n", BENCH_BATCH_KEYS);
+    for (int round = 0; round < 3; ++round) {
+        double t0 = bench_now();
+        for (size_t i = 0; i < BENCH_BATCH_KEYS; ++i) out[i] = polymur_hash(keys[i], lens[i], p, 0);
+        double t1 = bench_now();
+        polymur_hash_batch(keys, lens, BENCH_BATCH_KEYS, p, 0, out);
+        double t2 = bench_now();
+
+        // Hash followed by a random access into a large bucket array, the
+        // batched version processes chunks and prefetches the buckets.
+        uint64_t sum = 0;
+        for (size_t i = 0; i < BENCH_BATCH_KEYS; ++i) sum += buckets[polymur_hash(keys[i], lens[i], p, 0) & mask];
+        double t3 = bench_now();
+        for (size_t i = 0; i < BENCH_BATCH_KEYS; i += BENCH_BATCH_CHUNK) {
+            polymur_hash_batch_prefetch(keys + i, lens + i, BENCH_BATCH_CHUNK, p, 0, out,
+                                        buckets, sizeof(*buckets), mask);
+            for (size_t j = 0; j < BENCH_BATCH_CHUNK; ++j) sum += buckets[out[j] & mask];
+        }
+        double t4 = bench_now();
+        bench_sink += sum + out[0];
+
+        printf("  scalar %7.1f  batch %7.1f  scalar+probe %7.1f  batch+prefetch+probe %7.1f\n",
+               BENCH_BATCH_KEYS / (t1 - t0) / 1e6, BENCH_BATCH_KEYS / (t2 - t1) / 1e6,
+               BENCH_BATCH_KEYS / (t3 - t2) / 1e6, BENCH_BATCH_KEYS / (t4 - t3) / 1e6);
+    }
+
+    free(data); free(keys); free(lens); free(out); free(buckets);
+}
+
+
+// ---------- Fixed-width integer keys ----------
+#define BENCH_INTS_KEYS (1 << 16)
+
+static void bench_ints(const PolymurHashParams* p) {
+    uint64_t* k64 = (uint64_t*) bench_alloc(BENCH_INTS_KEYS * sizeof(*k64));
+    uint32_t* k32 = (uint32_t*) bench_alloc(BENCH_INTS_KEYS * sizeof(*k32));
+    uint64_t* out = (uint64_t*) bench_alloc(BENCH_INTS_KEYS * sizeof(*out));
+    for (size_t i = 0; i < BENCH_INTS_KEYS; ++i) k32[i] = (uint32_t) (k64[i] = polymur_mix(i));
+
+    const int reps = 200;
+    const double n = (double) BENCH_INTS_KEYS * reps;
+    printf("ints: %d keys, Mkeys/s\n", BENCH_INTS_KEYS);
+    for (int round = 0; round < 3; ++round) {
+        double t0 = bench_now();
+        for (int r = 0; r < reps; ++r) {
+            for (size_t i = 0; i < BENCH_INTS_KEYS; ++i) out[i] = polymur_hash((const uint8_t*) &k64[i], 8, p, 0);
+        }
+        double t1 = bench_now();
+        for (int r = 0; r < reps; ++r) polymur_hash_u64_array(k64, BENCH_INTS_KEYS, p, 0, out);
+        double t2 = bench_now();
+        for (int r = 0; r < reps; ++r) {
+            for (size_t i = 0; i < BENCH_INTS_KEYS; ++i) out[i] = polymur_hash((const uint8_t*) &k32[i], 4, p, 0);
+        }
+        double t3 = bench_now();
+        for (int r = 0; r < reps; ++r) polymur_hash_u32_array(k32, BENCH_INTS_KEYS, p, 0, out);
+        double t4 = bench_now();
+        bench_sink += out[0];
+
+        printf("  u64 scalar %7.1f  u64 array %7.1f  u32 scalar %7.1f  u32 array %7.1f\n",
+               n / (t1 - t0) / 1e6, n / (t2 - t1) / 1e6, n / (t3 - t2) / 1e6, n / (t4 - t3) / 1e6);
+    }
+
+    free(k64); free(k32); free(out);
+}
+
+
+// ---------- Columnar hashing ----------
+#define BENCH_COLUMN_ROWS (1 << 16)
+
+static void bench_column(const PolymurHashParams* p) {
+    int32_t* offsets = (int32_t*) bench_alloc((BENCH_COLUMN_ROWS + 1) * sizeof(*offsets));
+    uint8_t* validity = (uint8_t*) bench_alloc(BENCH_COLUMN_ROWS / 8);
+    uint64_t* out = (uint64_t*) bench_alloc(BENCH_COLUMN_ROWS * sizeof(*out));
+    offsets[0] = 0;
+    for (size_t i = 0; i < BENCH_COLUMN_ROWS; ++i) offsets[i + 1] = offsets[i] + (int32_t) (polymur_mix(i) % 33);
+    uint8_t* data = (uint8_t*) bench_alloc(offsets[BENCH_COLUMN_ROWS]);
+    for (int32_t i = 0; i < offsets[BENCH_COLUMN_ROWS]; ++i) data[i] = (uint8_t) polymur_mix(i);
+    for (size_t i = 0; i < BENCH_COLUMN_ROWS / 8; ++i) validity[i] = (uint8_t) ~(1 << (i % 8)); // 1/64 nulls.
+
+    const int reps = 100;
+    const double n = (double) BENCH_COLUMN_ROWS * reps;
+    printf("column: %d rows of random length 0..32 with nulls, Mrows/s\n", BENCH_COLUMN_ROWS);
+    for (int round = 0; round < 3; ++round) {
+        double t0 = bench_now();
+        for (int r = 0; r < reps; ++r) {
+            for (size_t i = 0; i < BENCH_COLUMN_ROWS; ++i) {
+                if ((validity[i / 8] >> (i % 8)) & 1) {
+                    out[i] = polymur_hash(data + offsets[i], offsets[i + 1] - offsets[i], p, 0);
+                } else {
+                    out[i] = polymur_column_null_hash(p, 0);
+                }
+            }
+        }
+        double t1 = bench_now();
+        for (int r = 0; r < reps; ++r) polymur_hash_column32(data, offsets, validity, NULL, BENCH_COLUMN_ROWS, p, 0, out);
+        double t2 = bench_now();
+        bench_sink += out[0];
+        printf("  row loop %7.1f  column kernel %7.1f\n", n / (t1 - t0) / 1e6, n / (t2 - t1) / 1e6);
+    }
+
+    free(offsets); free(validity); free(out); free(data);
+}
+
+
+// ---------- 128-bit hashing ----------
+static void bench_hash128(const PolymurHashParams* p) {
+    static const size_t sizes[] = {4, 16, 32, 48, 256, 4096, 65536};
+    PolymurHashParams128 p128;
+    p128.a = *p;
+    polymur_init_params(&p128.b, 1, 2);
+    uint8_t* buf = (uint8_t*) bench_alloc(65536 + 8);
+    printf("hash128: ns per hash, two 64-bit hashes vs one 128-bit hash\n");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        size_t reps = (64ULL << 20) / (sizes[i] < 256 ? 256 : sizes[i]);
+        double best2x64 = 1e100, best128 = 1e100;
+        for (int round = 0; round < 5; ++round) {
+            // Feed each hash into the next input offset so calls can't overlap.
+            uint64_t h = 0;
+            double t0 = bench_now();
+            for (size_t r = 0; r < reps; ++r) {
+                h += polymur_hash(buf + (h & 7), sizes[i], &p128.a, r);
+                h += polymur_hash(buf + (h & 7), sizes[i], &p128.b, r);
+            }
+            double t = bench_now() - t0;
+            if (t < best2x64) best2x64 = t;
+
+            t0 = bench_now();
+            for (size_t r = 0; r < reps; ++r) {
+                PolymurHash128 h128 = polymur_hash128(buf + (h & 7), sizes[i], &p128, r);
+                h += h128.lo ^ h128.hi;
+            }
+            t = bench_now() - t0;
+            if (t < best128) best128 = t;
+            bench_sink += h;
+        }
+        // From 4 KiB on with AVX-512 IFMA, hash128 makes one polymur_hash_poly611
+        // call per key, so it should never be slower than two 64-bit hashes.
+        int slower = sizes[i] >= 4096 && best128 > 1.05 * best2x64;
+        printf("  %6zu bytes  2x64 %8.2f  128 %8.2f  (%.2fx a single 64-bit hash)%s\n", sizes[i],
+               best2x64 / reps * 1e9, best128 / reps * 1e9, 2 * best128 / best2x64, slower ? "  SLOWER than 2x64" : "");
+    }
+    free(buf);
+}
+
+
+// ---------- Content-defined chunking ----------
+// The gear hash scan needs a byte load, a table load, a shift-add and a test
+// per byte, so it runs at about 1 byte per cycle, bounded by issue width and
+// load ports rather than latency. polymur_hash of the chunks is ~5x faster.
+#define BENCH_ROLL_SIZE (64 << 20)
+
+static void bench_roll(const PolymurHashParams* p) {
+    static const size_t windows[] = {16, 32, 48, 64};
+    uint8_t* buf = (uint8_t*) bench_alloc(BENCH_ROLL_SIZE);
+    for (size_t i = 0; i < BENCH_ROLL_SIZE; i += 8) {
+        uint64_t v = polymur_mix(i);
+        memcpy(buf + i, &v, 8);
+    }
+    PolymurRoller* r = (PolymurRoller*) bench_alloc(sizeof(PolymurRoller));
+    const char* unit = strcmp(bench_unit, "cycles") == 0 ? "cycle" : "ns";
+    printf("roll: bytes per %s and GB/s for 64 MiB, 2 KiB min, 8 KiB average, 64 KiB max chunks\n", unit);
+
+    double best_ticks = 1e100, best_time = 1e100;
+    for (int round = 0; round < 3; ++round) {
+        double t0 = bench_now();
+        uint64_t c0 = bench_ticks();
+        bench_sink += polymur_hash(buf, BENCH_ROLL_SIZE, p, 0);
+        double ticks = (double) (bench_ticks() - c0);
+        double t = bench_now() - t0;
+        if (ticks < best_ticks) best_ticks = ticks;
+        if (t < best_time) best_time = t;
+    }
+    printf("  polymur_hash only   %6.2f  %6.2f GB/s\n", BENCH_ROLL_SIZE / best_ticks, BENCH_ROLL_SIZE / best_time / 1e9);
+
+    for (size_t wi = 0; wi < sizeof(windows) / sizeof(windows[0]); ++wi) {
+        size_t nchunks = 0;
+        best_ticks = best_time = 1e100;
+        for (int round = 0; round < 3; ++round) {
+            polymur_roller_init(r, p, 0, windows[wi], (1 << 13) - 1, 2 << 10, 64 << 10);
+            const uint8_t* pos = buf;
+            size_t left = BENCH_ROLL_SIZE, used;
+            uint64_t h = 0, chunk_hash;
+            nchunks = 0;
+            double t0 = bench_now();
+            uint64_t c0 = bench_ticks();
+            while ((used = polymur_roller_update(r, pos, left, &chunk_hash))) {
+                h ^= chunk_hash;
+                pos += used;
+                left -= used;
+                ++nchunks;
+            }
+            if (polymur_roller_finish(r, &chunk_hash)) h ^= chunk_hash;
+            double ticks = (double) (bench_ticks() - c0);
+            double t = bench_now() - t0;
+            if (ticks < best_ticks) best_ticks = ticks;
+            if (t < best_time) best_time = t;
+            bench_sink += h;
+        }
+        printf("  window %2zu           %6.2f  %6.2f GB/s  (%zu byte average chunk)\n", windows[wi],
+               BENCH_ROLL_SIZE / best_ticks, BENCH_ROLL_SIZE / best_time / 1e9, BENCH_ROLL_SIZE / (nchunks + 1));
+    }
+    free(r);
+    free(buf);
+}
+
+
+// ---------- Sketches ----------
+#define BENCH_SKETCH_KEYS (1 << 16)
+#define BENCH_SKETCH_QUERIES (1 << 22)
+
+// The usual construction for comparison: k full hashes with different tweaks
+// into an unblocked filter, stopping at the first unset bit.
+static int bench_bloom_naive(const uint64_t* words, uint64_t nbits, const uint8_t* key, size_t len,
+                             const PolymurHashParams* p) {
+    for (uint64_t i = 0; i < 7; ++i) {
+        uint64_t bit = ((polymur_hash(key, len, p, i) >> 32) * nbits) >> 32;
+        if (!((words[bit >> 6] >> (bit & 63)) & 1)) return 0;
+    }
+    return 1;
+}
+
+static void bench_sketch(const PolymurHashParams* p) {
+    static const size_t sizes_mb[] = {1, 256};
+    uint8_t* data = (uint8_t*) bench_alloc(16 * BENCH_SKETCH_KEYS);
+    const uint8_t** keys = (const uint8_t**) bench_alloc(BENCH_SKETCH_QUERIES * sizeof(*keys));
+    size_t* lens = (size_t*) bench_alloc(BENCH_SKETCH_QUERIES * sizeof(*lens));
+    uint8_t* found = (uint8_t*) bench_alloc(BENCH_SKETCH_QUERIES);
+    uint32_t* est = (uint32_t*) bench_alloc(BENCH_SKETCH_QUERIES * sizeof(*est));
+    for (size_t i = 0; i < 16 * BENCH_SKETCH_KEYS; ++i) data[i] = (uint8_t) polymur_mix(i);
+    for (size_t i = 0; i < BENCH_SKETCH_QUERIES; ++i) {
+        keys[i] = data + 16 * (i % BENCH_SKETCH_KEYS);
+        lens[i] = 16;
+    }
+
+    printf("sketch: ns per 16-byte query, bloom filter with k = 7 and half its bits set, count-min with depth 4\n");
+    for (size_t si = 0; si < sizeof(sizes_mb) / sizeof(sizes_mb[0]); ++si) {
+        size_t bytes = sizes_mb[si] << 20;
+        uint64_t* words = (uint64_t*) bench_alloc(bytes + 64);
+        uint64_t* aligned = (uint64_t*) ((uintptr_t) words + (64 - (uintptr_t) words % 64) % 64);
+        for (size_t i = 0; i < bytes / 8; ++i) aligned[i] = polymur_mix(i);
+        PolymurBloom b;
+        polymur_bloom_init(&b, aligned, bytes / 64, 7, p, 0);
+        PolymurCountMin cm;
+        polymur_cm_init(&cm, (uint32_t*) aligned, bytes / 64, 4, p, 0);
+
+        double best[5] = {1e100, 1e100, 1e100, 1e100, 1e100};
+        for (int round = 0; round < 3; ++round) {
+            size_t hits = 0;
+            double t0 = bench_now();
+            for (size_t i = 0; i < BENCH_SKETCH_QUERIES; ++i) hits += bench_bloom_naive(aligned, 8 * bytes, keys[i], lens[i], p);
+            double t1 = bench_now();
+            for (size_t i = 0; i < BENCH_SKETCH_QUERIES; ++i) hits += polymur_bloom_query(&b, keys[i], lens[i]);
+            double t2 = bench_now();
+            polymur_bloom_query_batch(&b, keys, lens, BENCH_SKETCH_QUERIES, found);
+            double t3 = bench_now();
+            for (size_t i = 0; i < BENCH_SKETCH_QUERIES; ++i) hits += polymur_cm_estimate(&cm, keys[i], lens[i]);
+            double t4 = bench_now();
+            polymur_cm_estimate_batch(&cm, keys, lens, BENCH_SKETCH_QUERIES, est);
+            double t5 = bench_now();
+            double t[5] = {t1 - t0, t2 - t1, t3 - t2, t4 - t3, t5 - t4};
+            for (int j = 0; j < 5; ++j) if (t[j] < best[j]) best[j] = t[j];
+            bench_sink += hits + found[0] + est[0];
+        }
+        printf("  %4zu MiB  bloom: 7 hashes %6.2f  single %6.2f  batch %6.2f   count-min: single %6.2f  batch %6.2f\n",
+               sizes_mb[si], best[0] / BENCH_SKETCH_QUERIES * 1e9, best[1] / BENCH_SKETCH_QUERIES * 1e9,
+               best[2] / BENCH_SKETCH_QUERIES * 1e9, best[3] / BENCH_SKETCH_QUERIES * 1e9,
+               best[4] / BENCH_SKETCH_QUERIES * 1e9);
+        free(words);
+    }
+    free(est);
+    free(found);
+    free(lens);
+    free(keys);
+    free(data);
+}
+
+
+// ---------- Parallel hashing ----------
+typedef struct {
+    void (*task)(void* arg, size_t i);
+    void* arg;
+    size_t ntasks, nthreads, thread;
+} BenchWorker;
+
+static void* bench_worker_main(void* w_) {
+    BenchWorker* w = (BenchWorker*) w_;
+    for (size_t i = w->thread; i < w->ntasks; i += w->nthreads) w->task(w->arg, i);
+    return NULL;
+}
+
+// Executor for polymur_hash_parallel running on *(size_t*) ctx threads. The
+// tasks of threads that fail to start run on the calling thread.
+static void bench_thread_executor(void* ctx, void (*task)(void* arg, size_t i), void* arg, size_t ntasks) {
+    size_t nthreads = *(size_t*) ctx;
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > POLYMUR_MAX_SEGMENTS) nthreads = POLYMUR_MAX_SEGMENTS;
+    pthread_t threads[POLYMUR_MAX_SEGMENTS];
+    BenchWorker workers[POLYMUR_MAX_SEGMENTS];
+    for (size_t t = 0; t < nthreads; ++t) {
+        BenchWorker w = {task, arg, ntasks, nthreads, t};
+        workers[t] = w;
+    }
+
+    size_t nstarted = 1;
+    while (nstarted < nthreads) {
+        if (pthread_create(&threads[nstarted], NULL, bench_worker_main, &workers[nstarted])) break;
+        ++nstarted;
+    }
+    bench_worker_main(&workers[0]);
+    for (size_t t = nstarted; t < nthreads; ++t) bench_worker_main(&workers[t]);
+    for (size_t t = 1; t < nstarted; ++t) pthread_join(threads[t], NULL);
+}
+
+static void bench_parallel(const PolymurHashParams* p, size_t max_mb) {
+    size_t ncpu = (size_t) sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpu > POLYMUR_MAX_SEGMENTS) ncpu = POLYMUR_MAX_SEGMENTS;
+    uint8_t* buf = (uint8_t*) bench_alloc(max_mb << 20);
+    printf("parallel: GB/s (speedup) for 1..%zu threads\n", ncpu);
+    for (size_t size = 1 << 20; size <= (max_mb << 20); size *= 4) {
+        printf("  %5zu MiB", size >> 20);
+        double base = 0;
+        for (size_t nthreads = 1; nthreads <= ncpu; nthreads *= 2) {
+            double best = 1e100;
+            for (int round = 0; round < 3; ++round) {
+                double t0 = bench_now();
+                bench_sink += polymur_hash_parallel(buf, size, p, 0, nthreads, bench_thread_executor, &nthreads);
+                double t = bench_now() - t0;
+                if (t < best) best = t;
+            }
+            if (nthreads == 1) base = best;
+            printf("  %zut %6.2f (%4.2fx)", nthreads, size / best / 1e9, base / best);
+        }
+        printf("\n");
+    }
+    free(buf);
+}
+
+
+int main(int argc, char** argv) {
+    if (argc >= 2 && strcmp(argv[1], "--json") == 0) {
+        bench_json = 1;
+        --argc;
+        ++argv;
+    }
+    const char* which = argc >= 2 ? argv[1] : NULL;
+    PolymurHashParams p;
+    polymur_init_params_from_seed(&p, 0xfedbca9876543210ULL);
+    bench_init_counter();
+
+    // The maximum size in MiB for sizes and parallel can be given, e.g. 4096.
+    size_t max_mb = which && argc >= 3 ? (size_t) strtoull(argv[2], NULL, 10) : 0;
+    if (bench_json) {
+        if (which && strcmp(which, "lengths") && strcmp(which, "sizes") && strcmp(which, "mix")) {
+            fprintf(stderr, "--json is only supported for lengths, sizes and mix\n");
+            return 1;
+        }
+        printf("{\n  \"counter\": \"%s\",\n  \"unit\": \"%s\",\n  \"results\": [", bench_counter, bench_unit);
+        if (!which || strcmp(which, "lengths") == 0) bench_lengths(&p);
+        if (!which || strcmp(which, "sizes") == 0) bench_sizes(&p, max_mb ? max_mb : 1024);
+        if (!which || strcmp(which, "mix") == 0) bench_mixes(&p);
+        printf("\n  ]\n}\n");
+        return 0;
+    }
+
+    printf("counting %s using %s\n", bench_unit, bench_counter);
+    if (!which || strcmp(which, "lengths") == 0) bench_lengths(&p);
+    if (!which || strcmp(which, "sizes") == 0) bench_sizes(&p, max_mb ? max_mb : 1024);
+    if (!which || strcmp(which, "mix") == 0) bench_mixes(&p);
+    if (!which || strcmp(which, "seed") == 0) bench_seed();
+    if (!which || strcmp(which, "batch") == 0) bench_batch(&p);
+    if (!which || strcmp(which, "ints") == 0) bench_ints(&p);
+    if (!which || strcmp(which, "column") == 0) bench_column(&p);
+    if (!which || strcmp(which, "hash128") == 0) bench_hash128(&p);
+    if (!which || strcmp(which, "roll") == 0) bench_roll(&p);
+    if (!which || strcmp(which, "sketch") == 0) bench_sketch(&p);
+    if (!which || strcmp(which, "parallel") == 0) bench_parallel(&p, max_mb ? max_mb : 256);
+    return 0;
+}
@@ -0,0 +1,156 @@
+// Benchmarks for polymur-hash.hpp. Build with optimizations, for example
+//
+//     c++ -std=c++17 -O2 bench.cpp -o polymur-bench-cpp
+//
+// and run ./polymur-bench-cpp [name] to only run the named benchmark.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "polymur-hash.hpp"
+#include "polymur-map.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #include <x86intrin.h>
+    static uint64_t bench_ticks() { return __rdtsc(); }
+    static const char* const BENCH_UNIT = "cycles";
+#else
+    static uint64_t bench_ticks() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    static const char* const BENCH_UNIT = "ns";
+#endif
+
+static double bench_now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Prevents the compiler from optimizing away benchmarked computations.
+static volatile uint64_t bench_sink;
+
+
+// ---------- Fixed-length hashing ----------
+// Latency and reciprocal throughput of a single hash call for polymur_hash
+// with a length only known at runtime, polymur_hash with a constant length,
+// and polymur::hash<N>.
+static volatile size_t bench_opaque_len;
+static uint8_t bench_buf[64 + 8];
+
+// Runs reps dependent calls of f, each input offset depending on the previous
+// hash so calls can't overlap, and returns the best time per call.
+template<class F>
+static double bench_latency(F f) {
+    const size_t reps = 1 << 20;
+    double best = 1e100;
+    for (int round = 0; round < 10; ++round) {
+        uint64_t h = 0;
+        uint64_t t0 = bench_ticks();
+        for (size_t r = 0; r < reps; ++r) h = f(bench_buf + (h & 7), h);
+        double t = double(bench_ticks() - t0) / reps;
+        if (t < best) best = t;
+        bench_sink += h;
+    }
+    return best;
+}
+
+// Same as bench_latency, except that calls are independent.
+template<class F>
+static double bench_throughput(F f) {
+    const size_t reps = 1 << 20;
+    double best = 1e100;
+    for (int round = 0; round < 10; ++round) {
+        uint64_t h = 0;
+        uint64_t t0 = bench_ticks();
+        for (size_t r = 0; r < reps; ++r) h ^= f(bench_buf + (r & 7), r);
+        double t = double(bench_ticks() - t0) / reps;
+        if (t < best) best = t;
+        bench_sink += h;
+    }
+    return best;
+}
+
+template<size_t N>
+static void bench_length(const polymur::Params& p) {
+    bench_opaque_len = N;
+    size_t len = bench_opaque_len;
+    auto runtime_len = [&](const uint8_t* buf, uint64_t h) { return polymur_hash(buf, len, &p.c, h); };
+    auto const_len = [&](const uint8_t* buf, uint64_t h) { return polymur_hash(buf, N, &p.c, h); };
+    auto fixed = [&](const uint8_t* buf, uint64_t h) { return polymur::hash<N>(buf, p, h); };
+    std::printf("  N = %2zu  latency %6.1f %6.1f %6.1f   throughput %6.1f %6.1f %6.1f\n", N,
+                bench_latency(runtime_len), bench_latency(const_len), bench_latency(fixed),
+                bench_throughput(runtime_len), bench_throughput(const_len), bench_throughput(fixed));
+}
+
+static void bench_fixed(const polymur::Params& p) {
+    for (size_t i = 0; i < sizeof(bench_buf); ++i) bench_buf[i] = (uint8_t) polymur_mix(i);
+    std::printf("fixed: %s per call for polymur_hash(len), polymur_hash(N) and polymur::hash<N>\n", BENCH_UNIT);
+    bench_length<4>(p);
+    bench_length<8>(p);
+    bench_length<16>(p);
+    bench_length<32>(p);
+    bench_length<48>(p);
+}
+
+
+// ---------- Hash maps ----------
+// Millions of operations per second on n random 64-bit keys: inserting all
+// keys, looking all of them up in a different order, looking up n absent
+// keys, and erasing all keys. Repeated reps times on a fresh map.
+template<class Map>
+static void bench_map_ops(const char* name, const std::vector<uint64_t>& keys, const std::vector<uint64_t>& order,
+                          size_t reps) {
+    size_t n = order.size(); // Keys from n onwards are absent.
+    double t[4] = {0, 0, 0, 0};
+    uint64_t sum = 0;
+    for (size_t r = 0; r < reps; ++r) {
+        Map map;
+        double t0 = bench_now();
+        for (size_t i = 0; i < n; ++i) map[keys[i]] = i;
+        double t1 = bench_now();
+        for (size_t i = 0; i < n; ++i) sum += map.find(keys[order[i]])->second;
+        double t2 = bench_now();
+        for (size_t i = n; i < 2 * n; ++i) sum += map.find(keys[i]) != map.end();
+        double t3 = bench_now();
+        for (size_t i = 0; i < n; ++i) sum += map.erase(keys[order[i]]);
+        double t4 = bench_now();
+        t[0] += t1 - t0; t[1] += t2 - t1; t[2] += t3 - t2; t[3] += t4 - t3;
+    }
+    bench_sink += sum;
+    double ops = double(n) * reps / 1e6;
+    std::printf("    %-14s insert %7.1f  hit %7.1f  miss %7.1f  erase %7.1f\n", name,
+                ops / t[0], ops / t[1], ops / t[2], ops / t[3]);
+}
+
+static void bench_map(size_t max_n) {
+    std::printf("map: Mops/s for polymur::FlatMap and std::unordered_map, both using polymur::Hasher\n");
+    for (size_t n = 1000; n <= max_n; n *= 10) {
+        std::vector<uint64_t> keys(2 * n), order(n);
+        for (size_t i = 0; i < 2 * n; ++i) keys[i] = polymur_mix(i + n);
+        for (size_t i = 0; i < n; ++i) order[i] = i;
+        for (size_t i = n - 1; i > 0; --i) std::swap(order[i], order[polymur_mix(i) % (i + 1)]);
+
+        size_t reps = n < 1000000 ? 1000000 / n : 1;
+        std::printf("  %zu keys\n", n);
+        bench_map_ops<polymur::FlatMap<uint64_t, uint64_t>>("FlatMap", keys, order, reps);
+        bench_map_ops<std::unordered_map<uint64_t, uint64_t, polymur::Hasher>>("unordered_map", keys, order, reps);
+    }
+}
+
+
+int main(int argc, char** argv) {
+    const char* which = argc >= 2 ? argv[1] : nullptr;
+    polymur::Params p(0xfedbca9876543210ULL);
+
+    if (!which || std::strcmp(which, "fixed") == 0) bench_fixed(p);
+    if (!which || std::strcmp(which, "map") == 0) {
+        // The maximum number of keys in millions can be given, e.g. 100.
+        size_t max_n = which && argc >= 3 ? size_t(std::strtoull(argv[2], nullptr, 10)) * 1000000 : 10000000;
+        bench_map(max_n);
+    }
+    return 0;
+}
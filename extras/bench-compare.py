@@ -0,0 +1,48 @@
+"""Compares two `polymur-bench --json` outputs and reports regressions.
+
+    python3 bench-compare.py baseline.json new.json [threshold_percent]
+
+Exits with status 1 if any latency or throughput got slower, or any bulk
+bytes per tick got lower, by more than the threshold (default 10%).
+"""
+
+import json
+import sys
+
+def key(r):
+    if r["bench"] == "length": return ("length", r["len"], r["misalign"])
+    if r["bench"] == "size": return ("size", r["bytes"], r["misalign"])
+    return ("mix", r["min_len"], r["max_len"])
+
+# Metrics where lower is better, and where higher is better.
+LOWER = ["latency", "throughput"]
+HIGHER = ["bytes_per_tick"]
+
+def main():
+    if len(sys.argv) < 3:
+        print(__doc__)
+        return 2
+    with open(sys.argv[1]) as f: old = json.load(f)
+    with open(sys.argv[2]) as f: new = json.load(f)
+    threshold = float(sys.argv[3]) / 100 if len(sys.argv) > 3 else 0.10
+    if old["counter"] != new["counter"]:
+        print(f"warning: comparing {old['counter']} against {new['counter']} measurements")
+
+    old_results = {key(r): r for r in old["results"]}
+    regressions = 0
+    for r in new["results"]:
+        base = old_results.get(key(r))
+        if base is None: continue
+        for metric in LOWER + HIGHER:
+            if metric not in r: continue
+            change = r[metric] / base[metric] - 1 if base[metric] else 0
+            if metric in HIGHER: change = -change
+            if change > threshold:
+                regressions += 1
+                print(f"{' '.join(map(str, key(r)))} {metric}: {base[metric]} -> {r[metric]} ({change:+.0%} slower)")
+
+    print(f"{regressions} regressions above {threshold:.0%}")
+    return 1 if regressions else 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,186 @@
+/*
+    PolymurHash content-defined chunking, see polymur-hash.h for the license.
+
+    Splits a stream into chunks whose boundaries depend only on the bytes
+    around them, so that an insertion or deletion only changes the chunks it
+    touches, and hashes every chunk with polymur_hash in the same pass.
+*/
+
+#ifndef POLYMUR_CDC_H
+#define POLYMUR_CDC_H
+
+#include "polymur-hash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- PolymurHash chunking API ----------
+#define POLYMUR_ROLL_MAX_WINDOW 64
+
+// Rolling hash state for one stream. A chunk ends after byte i once it is at
+// least min_size bytes long and the rolling hash of the window bytes ending
+// at i is zero in all bits of mask, shifted up so that its highest bit is bit
+// 63, or when it reaches max_size bytes. With b bits in mask chunks are on
+// average min_size + 2^b bytes long.
+//
+// The rolling hash is a gear hash, as in FastCDC: the sum of T[x_j] << (64 - j)
+// mod 2^64 over the window bytes x_1 to x_w, oldest first, for a byte table T
+// keyed by the params, so boundaries can't be predicted without the key.
+// Rolling it is one table load, shift and add per byte, as the byte leaving
+// the window shifts out of the top by itself. It is not a polymur_hash of the
+// window: sliding a polynomial mod 2^61 - 1 needs a dependent 64 x 64 -> 128
+// bit multiplication and reduction per byte, capping it far below the speed
+// of the rest of the pass.
+typedef struct {
+    uint64_t gear[256];
+    uint64_t h, mask;
+    size_t window, min_size, max_size, chunk_len;
+    uint64_t tweak;
+    const PolymurHashParams* p;
+    PolymurHashState st;
+} PolymurRoller;
+
+// Window is clamped to at least the bit length of mask and 1, and at most
+// POLYMUR_ROLL_MAX_WINDOW bytes. A max_size of 0 means no limit. The params
+// must outlive the roller.
+static inline void polymur_roller_init(PolymurRoller* r, const PolymurHashParams* p, uint64_t tweak, size_t window,
+                                       uint64_t mask, size_t min_size, size_t max_size);
+
+// Consumes buf up to and including the end of the next chunk and returns the
+// number of bytes consumed, setting *chunk_hash to polymur_hash(chunk, chunk
+// length, p, tweak). The chunk may have started in earlier calls. Returns 0
+// if no chunk ends in buf, in which case all of it was consumed.
+static inline size_t polymur_roller_update(PolymurRoller* r, const uint8_t* buf, size_t len, uint64_t* chunk_hash);
+
+// Ends the stream, returning the length of the final partial chunk and
+// setting *chunk_hash to its hash if it is non-empty. The roller is then ready
+// for a new stream.
+static inline size_t polymur_roller_finish(PolymurRoller* r, uint64_t* chunk_hash);
+
+
+// ---------- Implementation ----------
+// Input is scanned in segments this large before being hashed, so the chunk
+// hash reads it from L1 cache.
+#define POLYMUR_ROLL_SEGMENT 8192
+#define POLYMUR_ROLL_SPLIT 256
+
+static inline void polymur_roller_reset(PolymurRoller* r) {
+    r->h = 0;
+    r->chunk_len = 0;
+    polymur_hash_init(&r->st, r->p, r->tweak);
+}
+
+static inline void polymur_roller_init(PolymurRoller* r, const PolymurHashParams* p, uint64_t tweak, size_t window,
+                                       uint64_t mask, size_t min_size, size_t max_size) {
+    size_t mask_bits = 0;
+    while (mask_bits < 64 && mask >> mask_bits) ++mask_bits;
+    if (window < mask_bits) window = mask_bits;
+    if (window < 1) window = 1;
+    if (window > POLYMUR_ROLL_MAX_WINDOW) window = POLYMUR_ROLL_MAX_WINDOW;
+    for (int b = 0; b < 256; ++b) {
+        r->gear[b] = polymur_mix(p->k + POLYMUR_ARBITRARY3 * (uint64_t) (b + 1)) ^ p->s;
+    }
+
+    // The scan keeps the window hash shifted down by 64 - window bits, whose
+    // low window bits only depend on the window bytes. The stream starts with
+    // an empty window.
+    r->mask = mask << (window - mask_bits);
+    r->window = window;
+    r->min_size = min_size;
+    r->max_size = max_size ? max_size : SIZE_MAX;
+    r->tweak = tweak;
+    r->p = p;
+    polymur_roller_reset(r);
+}
+
+// Rolls over up to n bytes, returning the length of the part of buf that ends
+// the current chunk, or 0 if it doesn't end in buf.
+static inline size_t polymur_roller_scan(PolymurRoller* r, const uint8_t* buf, size_t n) {
+    const uint64_t* gear = r->gear;
+    const uint64_t mask = r->mask;
+    const size_t w = r->window;
+    uint64_t h = r->h;
+
+    // No cuts are possible before index skip, and one is forced at force - 1.
+    size_t skip = r->min_size > r->chunk_len + 1 ? r->min_size - r->chunk_len - 1 : 0;
+    size_t force = r->max_size - r->chunk_len;
+    size_t end = n < force ? n : force;
+    size_t nocheck = skip < end ? skip : end;
+
+    // The hash only depends on the window, so bytes that can't end a chunk
+    // and don't reach into the window of the first byte that can are skipped.
+    size_t i = 0;
+    if (nocheck > w) {
+        h = 0;
+        i = nocheck - w;
+    }
+    for (; i < nocheck; ++i) h = (h << 1) + gear[buf[i]];
+    // Long ranges are scanned as two halves at once to overlap the latency of
+    // their hash chains, with the second half starting from its first window.
+    if (end - i >= POLYMUR_ROLL_SPLIT) {
+        size_t mid = i + (end - i) / 2, j = mid;
+        uint64_t g = 0;
+        for (size_t k = mid - w; k < mid; ++k) g = (g << 1) + gear[buf[k]];
+        for (; i < mid; ++i, ++j) {
+            h = (h << 1) + gear[buf[i]];
+            g = (g << 1) + gear[buf[j]];
+            if (!(h & mask) || !(g & mask)) break;
+        }
+        if (i < mid) {
+            if (!(h & mask)) goto cut;
+            // The second half ends a chunk at j, unless the first does earlier.
+            for (++i; i < mid; ++i) {
+                h = (h << 1) + gear[buf[i]];
+                if (!(h & mask)) goto cut;
+            }
+            h = g;
+            i = j;
+            goto cut;
+        }
+        h = g;
+        i = j;
+    }
+    for (; i < end; ++i) {
+        h = (h << 1) + gear[buf[i]];
+        if (!(h & mask)) goto cut;
+    }
+    r->h = h;
+    return end == force ? end : 0;
+
+cut:
+    r->h = h;
+    return i + 1;
+}
+
+static inline size_t polymur_roller_update(PolymurRoller* r, const uint8_t* buf, size_t len, uint64_t* chunk_hash) {
+    size_t done = 0;
+    while (done < len) {
+        size_t n = len - done < POLYMUR_ROLL_SEGMENT ? len - done : POLYMUR_ROLL_SEGMENT;
+        size_t cut = polymur_roller_scan(r, buf + done, n);
+        size_t used = cut ? cut : n;
+        polymur_hash_update(&r->st, buf + done, used);
+        r->chunk_len += used;
+        done += used;
+        if (cut) {
+            *chunk_hash = polymur_hash_finalize(&r->st);
+            polymur_hash_init(&r->st, r->p, r->tweak);
+            r->chunk_len = 0;
+            return done;
+        }
+    }
+    return 0;
+}
+
+static inline size_t polymur_roller_finish(PolymurRoller* r, uint64_t* chunk_hash) {
+    size_t len = r->chunk_len;
+    if (len) *chunk_hash = polymur_hash_finalize(&r->st);
+    polymur_roller_reset(r);
+    return len;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
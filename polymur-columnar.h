@@ -0,0 +1,123 @@
+/*
+    PolymurHash columnar kernels, see polymur-hash.h for the license.
+
+    Hashes whole string columns stored in the Apache Arrow layout: a contiguous
+    data buffer with an offsets array such that row i spans the bytes
+    data[offsets[i]] up to data[offsets[i + 1]].
+*/
+
+#ifndef POLYMUR_COLUMNAR_H
+#define POLYMUR_COLUMNAR_H
+
+#include "polymur-hash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- PolymurHash columnar API ----------
+// Hashes n rows of a string column into out, with out[j] equal to
+// polymur_hash(row, len, p, tweak) for row sel[j], or row j if sel is NULL.
+// The validity bitmap is LSB-first like Arrow's, with a zero bit marking a
+// null row, and may be NULL if all rows are valid. Null rows get the fixed
+// hash polymur_column_null_hash(p, tweak).
+static inline void polymur_hash_column32(const uint8_t* data, const int32_t* offsets, const uint8_t* validity,
+                                         const uint32_t* sel, size_t n, const PolymurHashParams* p,
+                                         uint64_t tweak, uint64_t* out);
+static inline void polymur_hash_column64(const uint8_t* data, const int64_t* offsets, const uint8_t* validity,
+                                         const uint32_t* sel, size_t n, const PolymurHashParams* p,
+                                         uint64_t tweak, uint64_t* out);
+
+// Same as above, except that each row is hashed with the existing value of
+// out[j] as its tweak. Hashing the first key column with polymur_hash_column
+// and every subsequent one with polymur_combine_column gives a hash for
+// multi-column keys.
+static inline void polymur_combine_column32(const uint8_t* data, const int32_t* offsets, const uint8_t* validity,
+                                            const uint32_t* sel, size_t n, const PolymurHashParams* p, uint64_t* out);
+static inline void polymur_combine_column64(const uint8_t* data, const int64_t* offsets, const uint8_t* validity,
+                                            const uint32_t* sel, size_t n, const PolymurHashParams* p, uint64_t* out);
+
+// The hash given to null rows.
+static inline uint64_t polymur_column_null_hash(const PolymurHashParams* p, uint64_t tweak);
+
+
+// ---------- Implementation ----------
+#define POLYMUR_COLUMN_NULL 0x510e527fade682d1ULL // Fractional bits of sqrt(11).
+
+static inline uint64_t polymur_column_null_hash(const PolymurHashParams* p, uint64_t tweak) {
+    return polymur_mix(tweak ^ POLYMUR_COLUMN_NULL) + p->s;
+}
+
+// Shared implementation, offsets are int64_t if wide and int32_t otherwise.
+// If combine is set the tweak is taken from out per row. Always inlined with
+// constant wide and combine, so neither costs a branch per row.
+static inline void polymur_column_impl(const uint8_t* data, const void* offsets, int wide, const uint8_t* validity,
+                                       const uint32_t* sel, size_t n, const PolymurHashParams* p,
+                                       int combine, uint64_t tweak, uint64_t* out) {
+    PolymurBatchPowers kp;
+    polymur_batch_powers(p, &kp);
+    const uint8_t* keys[POLYMUR_BATCH_CHUNK];
+    size_t lens[POLYMUR_BATCH_CHUNK];
+    uint64_t acc[POLYMUR_BATCH_CHUNK];
+    uint8_t pos[POLYMUR_BATCH_CHUNK];
+
+    for (size_t base = 0; base < n; base += POLYMUR_BATCH_CHUNK) {
+        size_t w = n - base < POLYMUR_BATCH_CHUNK ? n - base : POLYMUR_BATCH_CHUNK;
+        uint64_t* co = out + base;
+
+        // Gather the valid rows of this chunk, nulls are written directly.
+        size_t nvalid = 0;
+        for (size_t j = 0; j < w; ++j) {
+            size_t row = sel ? sel[base + j] : base + j;
+            uint64_t t = combine ? co[j] : tweak;
+            if (validity && !((validity[row >> 3] >> (row & 7)) & 1)) {
+                co[j] = polymur_column_null_hash(p, t);
+                continue;
+            }
+            int64_t begin, end;
+            if (wide) {
+                begin = ((const int64_t*) offsets)[row];
+                end = ((const int64_t*) offsets)[row + 1];
+            } else {
+                begin = ((const int32_t*) offsets)[row];
+                end = ((const int32_t*) offsets)[row + 1];
+            }
+            keys[nvalid] = data + begin;
+            lens[nvalid] = (size_t) (end - begin);
+            acc[nvalid] = t;
+            pos[nvalid] = (uint8_t) j;
+            ++nvalid;
+        }
+
+        polymur_poly611_chunk(keys, lens, nvalid, p, &kp, acc);
+        for (size_t v = 0; v < nvalid; ++v) co[pos[v]] = polymur_mix(acc[v]) + p->s;
+    }
+}
+
+static inline void polymur_hash_column32(const uint8_t* data, const int32_t* offsets, const uint8_t* validity,
+                                         const uint32_t* sel, size_t n, const PolymurHashParams* p,
+                                         uint64_t tweak, uint64_t* out) {
+    polymur_column_impl(data, offsets, 0, validity, sel, n, p, 0, tweak, out);
+}
+
+static inline void polymur_hash_column64(const uint8_t* data, const int64_t* offsets, const uint8_t* validity,
+                                         const uint32_t* sel, size_t n, const PolymurHashParams* p,
+                                         uint64_t tweak, uint64_t* out) {
+    polymur_column_impl(data, offsets, 1, validity, sel, n, p, 0, tweak, out);
+}
+
+static inline void polymur_combine_column32(const uint8_t* data, const int32_t* offsets, const uint8_t* validity,
+                                            const uint32_t* sel, size_t n, const PolymurHashParams* p, uint64_t* out) {
+    polymur_column_impl(data, offsets, 0, validity, sel, n, p, 1, 0, out);
+}
+
+static inline void polymur_combine_column64(const uint8_t* data, const int64_t* offsets, const uint8_t* validity,
+                                            const uint32_t* sel, size_t n, const PolymurHashParams* p, uint64_t* out) {
+    polymur_column_impl(data, offsets, 1, validity, sel, n, p, 1, 0, out);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
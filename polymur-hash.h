@@ -32,12 +32,26 @@ extern "C" {
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/uio.h>
+    #define POLYMUR_HAS_IOVEC 1
+#endif
+// The AVX-512 IFMA kernels need GCC 6 or Clang 6 for the intrinsics and
+// runtime detection. Define POLYMUR_NO_SIMD to leave out <immintrin.h>.
+#if defined(__x86_64__) && !defined(POLYMUR_NO_SIMD) && \
+    ((defined(__clang__) && __clang_major__ >= 6) || (!defined(__clang__) && defined(__GNUC__) && __GNUC__ >= 6))
+    #include <immintrin.h>
+    #define POLYMUR_HAS_AVX512IFMA 1
+#endif
 #if defined(_MSC_VER)
     #include <intrin.h>
     #ifdef _M_X64
         #pragma intrinsic(_umul128)
     #endif
 #endif
+#if defined(POLYMUR_INSTRUMENT) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #include <x86intrin.h>
+#endif
     
 // ---------- PolymurHash public API ----------
 typedef struct {
@@ -48,11 +62,138 @@ typedef struct {
 static inline void polymur_init_params(PolymurHashParams* p, uint64_t k_seed, uint64_t s_seed);
 static inline void polymur_init_params_from_seed(PolymurHashParams* p, uint64_t seed);
 
+// Gives the same parameters as polymur_init_params, several times faster
+// using a 2 KiB table.
+static inline void polymur_init_params_fast(PolymurHashParams* p, uint64_t k_seed, uint64_t s_seed);
+
+// Sets p[i] to the same parameters polymur_init_params_from_seed gives for
+// seed + i, for i < n. Uses the same table, and interleaves the expansion of
+// several seeds.
+static inline void polymur_init_params_many(PolymurHashParams* p, size_t n, uint64_t seed);
+
 // Computes the full hash of buf. The tweak is added to the hash before final
 // mixing, allowing different outputs much faster than re-seeding. No claims are
 // made about the collision probability between hashes with different tweaks.
 static inline uint64_t polymur_hash(const uint8_t* buf, size_t len, const PolymurHashParams* p, uint64_t tweak);
 
+// Incremental hashing of input that arrives in pieces. After initialization
+// any number of updates can be done, after which finalization gives the same
+// hash as polymur_hash would on the concatenation of all updates. Only the
+// last partial 49-byte block is buffered, the rest is hashed in-place. The
+// params must outlive the state.
+typedef struct {
+    const PolymurHashParams* p;
+    uint64_t k3, k4, k5, k6;
+    uint64_t h, tweak, nblocks;
+    size_t buf_len;
+    uint8_t buf[56]; // Only 49 bytes are used, block loads read one byte past.
+} PolymurHashState;
+
+static inline void polymur_hash_init(PolymurHashState* st, const PolymurHashParams* p, uint64_t tweak);
+static inline void polymur_hash_update(PolymurHashState* st, const uint8_t* buf, size_t len);
+static inline uint64_t polymur_hash_finalize(const PolymurHashState* st);
+
+// Hashes n keys at once, setting out[i] = polymur_hash(keys[i], lens[i], p, tweak).
+// Keys are grouped by length in chunks of 64, so that the hash loops do not
+// mispredict on mixed lengths, and all powers of k are computed once per batch.
+static inline void polymur_hash_batch(const uint8_t* const* keys, const size_t* lens, size_t n,
+                                      const PolymurHashParams* p, uint64_t tweak, uint64_t* out);
+
+// Same as polymur_hash_batch, but also prefetches the bucket at
+// buckets + (out[i] & bucket_mask) * bucket_size as soon as out[i] is known.
+static inline void polymur_hash_batch_prefetch(const uint8_t* const* keys, const size_t* lens, size_t n,
+                                               const PolymurHashParams* p, uint64_t tweak, uint64_t* out,
+                                               const void* buckets, size_t bucket_size, uint64_t bucket_mask);
+
+// Hashes n integers at once, setting out[i] = polymur_hash((const uint8_t*) &keys[i], sizeof(keys[i]), p, tweak).
+// These skip all length dispatch, and use AVX-512 IFMA if available at runtime.
+static inline void polymur_hash_u64_array(const uint64_t* keys, size_t n, const PolymurHashParams* p, uint64_t tweak, uint64_t* out);
+static inline void polymur_hash_u32_array(const uint32_t* keys, size_t n, const PolymurHashParams* p, uint64_t tweak, uint64_t* out);
+
+// Digests of whole 49-byte blocks, which can be concatenated and patched
+// without rehashing. A digest holds the block polynomial polymur_hash_poly611
+// builds before the final block, fully reduced mod 2^61 - 1, and its number
+// of blocks. Together with the final 1 to 49 bytes it gives the full hash.
+typedef struct {
+    uint64_t h, nblocks;
+} PolymurDigest;
+
+static inline void polymur_digest_blocks(PolymurDigest* d, const uint8_t* buf, size_t nblocks, const PolymurHashParams* p);
+
+// Returns the digest of the blocks of a followed by those of b.
+static inline PolymurDigest polymur_concat(const PolymurHashParams* p, PolymurDigest a, PolymurDigest b);
+
+// Updates the digest for overwriting nblocks blocks starting at block index
+// first, from old_blocks to new_blocks. Requires first + nblocks <= d->nblocks,
+// otherwise 0 is returned and d is left unchanged. Returns 1 on success.
+static inline int polymur_digest_patch(PolymurDigest* d, uint64_t first, const uint8_t* old_blocks,
+                                       const uint8_t* new_blocks, size_t nblocks, const PolymurHashParams* p);
+
+// Computes polymur_hash of the blocks in d followed by the final tail_len
+// bytes, where 1 <= tail_len <= 49 (or tail_len <= 49 if d is empty), and
+// stores it in out. With probability 2^-58 the result can not be derived from
+// the digest alone, in which case 0 is returned and the input must be hashed
+// directly. Returns 1 on success.
+static inline int polymur_digest_finalize(const PolymurDigest* d, const uint8_t* tail, size_t tail_len,
+                                          const PolymurHashParams* p, uint64_t tweak, uint64_t* out);
+
+// Hashes a large buffer by splitting it into up to POLYMUR_MAX_SEGMENTS
+// segments that are hashed independently, giving the same result as
+// polymur_hash. The executor is called once and must call task(arg, i) for
+// all i < ntasks, possibly concurrently, before returning. If executor is
+// NULL the segments are hashed serially.
+typedef void (*polymur_executor_fn)(void* ctx, void (*task)(void* arg, size_t i), void* arg, size_t ntasks);
+static inline uint64_t polymur_hash_parallel(const uint8_t* buf, size_t len, const PolymurHashParams* p, uint64_t tweak,
+                                             size_t nsegments, polymur_executor_fn executor, void* ctx);
+
+// 128-bit hashes for when the 64-bit collision bound is not enough. The two
+// halves are exactly polymur_hash with two independent sets of parameters,
+// computed in a single pass sharing all loads, except from 4 KiB on with
+// AVX-512 IFMA where two vectorized passes are faster. See
+// extras/128-bit-output.md for the collision bound, which requires all four
+// seeds to be chosen independently.
+typedef struct {
+    PolymurHashParams a, b;
+} PolymurHashParams128;
+
+typedef struct {
+    uint64_t lo, hi;
+} PolymurHash128;
+
+static inline void polymur_init_params128(PolymurHashParams128* p, uint64_t ka_seed, uint64_t sa_seed,
+                                          uint64_t kb_seed, uint64_t sb_seed);
+static inline void polymur_init_params128_from_seed(PolymurHashParams128* p, uint64_t seed);
+static inline PolymurHash128 polymur_hash128(const uint8_t* buf, size_t len, const PolymurHashParams128* p, uint64_t tweak);
+
+#ifdef POLYMUR_HAS_IOVEC
+// Computes the same hash as polymur_hash would on the concatenation of the n
+// buffers in iov, without copying them into a contiguous buffer first.
+static inline uint64_t polymur_hash_iov(const struct iovec* iov, int n, const PolymurHashParams* p, uint64_t tweak);
+#endif
+
+#ifdef POLYMUR_INSTRUMENT
+// Statistics of polymur_hash calls, only available when compiled with
+// POLYMUR_INSTRUMENT defined (GCC, Clang or MSVC). Calls are split into the
+// length classes of polymur_hash_poly611: 0 to 7 bytes, 8 to 49 bytes, and 50
+// bytes or more. One in every POLYMUR_INSTRUMENT_SAMPLE calls per thread and
+// class (default 256) is also timed, in ticks of the cycle counter where
+// available, which include the overhead of reading the counter.
+// Each thread counts into its own counters, which are never freed, so that
+// counts of exited threads are kept.
+#define POLYMUR_STATS_CLASSES 3
+
+typedef struct {
+    uint64_t calls[POLYMUR_STATS_CLASSES];
+    uint64_t bytes[POLYMUR_STATS_CLASSES];
+    uint64_t sampled_calls[POLYMUR_STATS_CLASSES];
+    uint64_t sampled_ticks[POLYMUR_STATS_CLASSES];
+} PolymurStats;
+
+// Sums the counters of all threads and all translation units, without locks.
+// Counts from other threads may lag slightly behind.
+static inline void polymur_stats_snapshot(PolymurStats* out);
+#endif
+
 
 // ---------- Cross-platform compatibility ----------
 #if (defined(__GNUC__) || defined(__clang__) || defined(__INTEL_COMPILER))
@@ -63,6 +204,14 @@ static inline uint64_t polymur_hash(const uint8_t* buf, size_t len, const Polymu
     #define POLYMUR_UNLIKELY(x) (!!(x))
 #endif
 
+#if (defined(__GNUC__) || defined(__clang__) || defined(__INTEL_COMPILER))
+    #define POLYMUR_PREFETCH(p) __builtin_prefetch(p)
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #define POLYMUR_PREFETCH(p) _mm_prefetch((const char*) (p), _MM_HINT_T0)
+#else
+    #define POLYMUR_PREFETCH(p) ((void) (p))
+#endif
+
 // No #ifdefs needed, modern compilers all optimize this away.
 static inline int polymur_is_little_endian(void) {
     uint32_t v = 1;
@@ -121,6 +270,9 @@ static inline uint64_t polymur_load_le_u64_0_8(const uint8_t* buf, size_t len) {
         return (((uint64_t) x) & POLYMUR_P611) + ((uint64_t) (x >> 61));
     }
 #else
+    // Also the 32-bit path. Keeping sums of products as unpropagated 32-bit
+    // columns and resolving carries once per block was measured on i386 and is
+    // not faster: it needs more live registers than the carries it saves.
     typedef struct {
         uint64_t lo;
         uint64_t hi;
@@ -164,6 +316,79 @@ static inline uint64_t polymur_extrared611(uint64_t x) {
     return (x & POLYMUR_P611) + (x >> 61);
 }
 
+// Fully reduces x mod 2^61 - 1.
+static inline uint64_t polymur_canon611(uint64_t x) {
+    x = polymur_extrared611(x);
+    return x >= POLYMUR_P611 ? x - POLYMUR_P611 : x;
+}
+
+// Computes a * b mod 2^61 - 1 fully reduced, for a, b < 2^62.
+static inline uint64_t polymur_mulmod611(uint64_t a, uint64_t b) {
+    return polymur_canon611(polymur_red611(polymur_mul128(a, b)));
+}
+
+// Computes x^e mod 2^61 - 1 fully reduced, for x < 2^62.
+static inline uint64_t polymur_powmod611(uint64_t x, uint64_t e) {
+    uint64_t r = 1;
+    x = polymur_canon611(x);
+    for (; e; e >>= 1) {
+        if (e & 1) r = polymur_mulmod611(r, x);
+        x = polymur_mulmod611(x, x);
+    }
+    return r;
+}
+
+
+#ifdef POLYMUR_HAS_AVX512IFMA
+// ---------- AVX-512 IFMA arithmetic ----------
+// The 64 x 64 -> 128 bit products are split into 52-bit limbs, whose partial
+// products are accumulated exactly by IFMA in three 52-bit columns. Each sum
+// of partial products is reconstructed exactly, so polymur_red611 is
+// bit-identical to the scalar path. Only selected at runtime if supported.
+#define POLYMUR_AVX512_TARGET __attribute__((target("avx512f,avx512dq,avx512ifma")))
+
+// The unmasked shifts, conversions and gathers in GCC's headers merge into an
+// uninitialized vector, which g++ -Wall reports as -Wuninitialized once
+// inlined into user code. The zero-masked forms with a full mask compile to
+// the same instructions.
+#define POLYMUR_AVX512_SRLI(x, n) _mm512_maskz_srli_epi64((__mmask8) 0xff, x, n)
+#define POLYMUR_AVX512_SLLI(x, n) _mm512_maskz_slli_epi64((__mmask8) 0xff, x, n)
+#define POLYMUR_AVX512_GATHER(idx, ptr) \
+    _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), (__mmask8) 0xff, idx, (const void*) (ptr), 1)
+
+static inline int polymur_cpu_has_avx512ifma(void) {
+    return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")
+        && __builtin_cpu_supports("avx512ifma");
+}
+
+// Accumulates a * b into 52-bit columns c0, c1, c2, for a, b < 2^104.
+static inline POLYMUR_AVX512_TARGET void polymur_avx512_mul_acc(__m512i a, __m512i b, __m512i* c0, __m512i* c1, __m512i* c2) {
+    const __m512i m52 = _mm512_set1_epi64((1ULL << 52) - 1);
+    __m512i a0 = _mm512_and_si512(a, m52), a1 = POLYMUR_AVX512_SRLI(a, 52);
+    __m512i b0 = _mm512_and_si512(b, m52), b1 = POLYMUR_AVX512_SRLI(b, 52);
+    *c0 = _mm512_madd52lo_epu64(*c0, a0, b0);
+    *c1 = _mm512_madd52hi_epu64(*c1, a0, b0);
+    *c1 = _mm512_madd52lo_epu64(*c1, a0, b1);
+    *c1 = _mm512_madd52lo_epu64(*c1, a1, b0);
+    *c2 = _mm512_madd52hi_epu64(*c2, a0, b1);
+    *c2 = _mm512_madd52hi_epu64(*c2, a1, b0);
+    *c2 = _mm512_madd52lo_epu64(*c2, a1, b1);
+}
+
+// polymur_red611 of c0 + c1 * 2^52 + c2 * 2^104, given that this sum is < 2^125.
+static inline POLYMUR_AVX512_TARGET __m512i polymur_avx512_red611(__m512i c0, __m512i c1, __m512i c2) {
+    const __m512i m52 = _mm512_set1_epi64((1ULL << 52) - 1);
+    const __m512i m9 = _mm512_set1_epi64((1ULL << 9) - 1);
+    c1 = _mm512_add_epi64(c1, POLYMUR_AVX512_SRLI(c0, 52));
+    c0 = _mm512_and_si512(c0, m52);
+    c2 = _mm512_add_epi64(c2, POLYMUR_AVX512_SRLI(c1, 52));
+    c1 = _mm512_and_si512(c1, m52);
+    __m512i lo = _mm512_or_si512(c0, POLYMUR_AVX512_SLLI(_mm512_and_si512(c1, m9), 52));
+    __m512i hi = _mm512_or_si512(POLYMUR_AVX512_SRLI(c1, 9), POLYMUR_AVX512_SLLI(c2, 43));
+    return _mm512_add_epi64(lo, hi);
+}
+#endif
+
 
 // ---------- Hash function ----------
 #define POLYMUR_ARBITRARY1 0x6a09e667f3bcc908ULL // Completely arbitrary, these
@@ -181,12 +406,41 @@ static inline uint64_t polymur_mix(uint64_t x) {
     return x;
 }
 
+// Advances k_seed until it gives a random exponent coprime to 2^61 - 2, and
+// returns that exponent. ~35.3% of candidates succeed.
+static inline uint64_t polymur_init_exponent(uint64_t* k_seed) {
+    while (1) {
+        *k_seed += POLYMUR_ARBITRARY2;
+        uint64_t e = (*k_seed >> 3) | 1; // e < 2^61, odd.
+        if (e % 3 == 0) continue;
+        if (!(e % 5 && e % 7)) continue;
+        if (!(e % 11 && e % 13 && e % 31)) continue;
+        if (!(e % 41 && e % 61 && e % 151 && e % 331 && e % 1321)) continue;
+        return e;
+    }
+}
+
+// Sets the key from k = ka * kb, returning whether it is usable.
+static inline int polymur_init_key(PolymurHashParams* p, uint64_t ka, uint64_t kb) {
+    uint64_t k = polymur_extrared611(polymur_red611(polymur_mul128(ka, kb)));
+
+    // ~46.875% success rate. Bound on k^7 needed for efficient reduction.
+    p->k = polymur_extrared611(k);
+    p->k2 = polymur_extrared611(polymur_red611(polymur_mul128(p->k,  p->k)));
+    uint64_t k3 =               polymur_red611(polymur_mul128(p->k,  p->k2));
+    uint64_t k4 =               polymur_red611(polymur_mul128(p->k2, p->k2));
+    p->k7 = polymur_extrared611(polymur_red611(polymur_mul128(k3, k4)));
+    return p->k7 < (1ULL << 60) - (1ULL << 56);
+    // Our key space is log2(totient(2^61 - 2) * (2^60-2^56)/2^61) ~= 57.4 bits.
+}
+
 static inline void polymur_init_params(PolymurHashParams* p, uint64_t k_seed, uint64_t s_seed) {
     p->s = s_seed ^ POLYMUR_ARBITRARY1; // People love to pass zero.
     
     // POLYMUR_POW37[i] = 37^(2^i) mod (2^61 - 1)
     // Could be replaced by a 512 byte LUT, costs ~400 byte overhead but 2x
-    // faster seeding. However, seeding is rather rare, so I chose not to.
+    // faster seeding. However, seeding is rather rare, so I chose not to. If
+    // it isn't for you, see polymur_init_params_fast.
     uint64_t POLYMUR_POW37[64];
     POLYMUR_POW37[0] = 37; POLYMUR_POW37[32] = 559096694736811184ULL;
     for (int i = 0; i < 31; ++i) {
@@ -195,13 +449,7 @@ static inline void polymur_init_params(PolymurHashParams* p, uint64_t k_seed, ui
     }
     
     while (1) {
-        // Choose a random exponent coprime to 2^61 - 2. ~35.3% success rate.
-        k_seed += POLYMUR_ARBITRARY2;
-        uint64_t e = (k_seed >> 3) | 1; // e < 2^61, odd.
-        if (e % 3 == 0) continue;
-        if (!(e % 5 && e % 7)) continue;
-        if (!(e % 11 && e % 13 && e % 31)) continue;
-        if (!(e % 41 && e % 61 && e % 151 && e % 331 && e % 1321)) continue;
+        uint64_t e = polymur_init_exponent(&k_seed);
         
         // Compute k = 37^e mod 2^61 - 1. Since e is coprime with the order of
         // the multiplicative group mod 2^61 - 1 and 37 is a generator, this
@@ -211,30 +459,253 @@ static inline void polymur_init_params(PolymurHashParams* p, uint64_t k_seed, ui
             if (e & 1) ka = polymur_extrared611(polymur_red611(polymur_mul128(ka, POLYMUR_POW37[i])));
             if (e & 2) kb = polymur_extrared611(polymur_red611(polymur_mul128(kb, POLYMUR_POW37[i+1])));
         }
-        uint64_t k = polymur_extrared611(polymur_red611(polymur_mul128(ka, kb)));
+        if (polymur_init_key(p, ka, kb)) break;
+    }
+}
+
+// POLYMUR_POW37_WINDOW[i][j] = 37^(j * 16^i) mod (2^61 - 1), for exponentiation
+// by 4-bit windows in polymur_init_params_fast. 2 KiB, but it needs only 16
+// multiplications per exponent rather than ~30 poorly predicted branches
+// around 62 multiplications.
+static const uint64_t POLYMUR_POW37_WINDOW[16][16] = {
+    {0x0000000000000001ULL, 0x0000000000000025ULL, 0x0000000000000559ULL, 0x000000000000c5ddULL,
+     0x00000000001c98f1ULL, 0x0000000004221ad5ULL, 0x0000000098ede0c9ULL, 0x000000161a617d0dULL,
+     0x00000331d01712e1ULL, 0x000076331355ba85ULL, 0x00111561cb63f539ULL, 0x027817226572713dULL,
+     0x1b5b57f8a98a5dd3ULL, 0x1433b6f080ff8f9eULL, 0x0b7970c2a4efc1edULL, 0x088d4c21d6a7074eULL},
+    {0x0000000000000001ULL, 0x1c6c00e406240e4fULL, 0x0445a08cc8f3a1a4ULL, 0x1ebd842364fb06bcULL,
+     0x153d5f6f3a497909ULL, 0x1843a2ed004f4296ULL, 0x028a84f675e9042eULL, 0x06a20e414e04d637ULL,
+     0x173406b3458815fbULL, 0x01f6406bb083e474ULL, 0x0ff13d9f28545e1bULL, 0x02d512fcc352b37eULL,
+     0x183df28e6cbc4986ULL, 0x0ab6d96d52d2e4f1ULL, 0x10a5b897c1c96aa8ULL, 0x1c2a6b2b2a506cb5ULL},
+    {0x0000000000000001ULL, 0x0904436a268fe45fULL, 0x1a0447d6401bd149ULL, 0x1686d8fbcf3f2277ULL,
+     0x001545050f7fd8d2ULL, 0x0d7a7c7ac2e93db5ULL, 0x102d3141a6637ecaULL, 0x0c1ab12c1201c2caULL,
+     0x1943f5989f8137b4ULL, 0x15e60078d5d3aacaULL, 0x06add88680feb415ULL, 0x1b70da3376fd9f91ULL,
+     0x1c6656c1c1e08242ULL, 0x145728ab46cec9f8ULL, 0x06d6a3fc4bd9203dULL, 0x041cbedd21cfec18ULL},
+    {0x0000000000000001ULL, 0x059d323d0cc88d0cULL, 0x090375f62a6190f7ULL, 0x0a0f66515f454cfbULL,
+     0x0f5c7c2e821b1dbcULL, 0x126d117d6c80dac0ULL, 0x0b3ae416ef702d73ULL, 0x12a24d53ff35d6ceULL,
+     0x172c1c59c06a5dc5ULL, 0x1b5c9dd958969af1ULL, 0x12fc4059c4fee2ccULL, 0x1e1adf8c7a6fd6d8ULL,
+     0x163c36f978399bfbULL, 0x13a96ef73203f026ULL, 0x1e1f510335fab939ULL, 0x09499f9e5ecd1011ULL},
+    {0x0000000000000001ULL, 0x1197a9625e04d15bULL, 0x13a7ec449ee251b5ULL, 0x1423b9e197fffc92ULL,
+     0x15b61eda2303dfe5ULL, 0x027d8fc23a269909ULL, 0x11ddc8ce3346e2d7ULL, 0x0f59d2a8e735ed33ULL,
+     0x0a342248fe30f56dULL, 0x0da9b14f71a7e020ULL, 0x05a92173c8a76598ULL, 0x1ad5eee6600993a3ULL,
+     0x11f9fa84234a965dULL, 0x0ff5d296b7699bb3ULL, 0x0f948dfdabfa78a6ULL, 0x16d9c33bb01e45beULL},
+    {0x0000000000000001ULL, 0x14a91c0e70fe4b92ULL, 0x125293744a6787faULL, 0x0ea1805500705520ULL,
+     0x184216046a8d7de9ULL, 0x092057fee583cde7ULL, 0x18a937ea52adde21ULL, 0x14107b9bdf3566ddULL,
+     0x00f11f4265c935b5ULL, 0x0a0eb68277852815ULL, 0x0f9efccff6e4e03dULL, 0x0e7e0fd2574be167ULL,
+     0x00936d6d961989fdULL, 0x066b048459dcd441ULL, 0x0e55a4f717320befULL, 0x1f8e74a45b0ba680ULL},
+    {0x0000000000000001ULL, 0x1e0b02b92a24c7acULL, 0x1834064a42aa1ff0ULL, 0x1c734b27fbf088f6ULL,
+     0x01043e4a05505f25ULL, 0x07ebb274735a55d2ULL, 0x01cad0725351abd9ULL, 0x196aac5d1d4ad510ULL,
+     0x03d96ecbb8925533ULL, 0x095ce6b40bcf98caULL, 0x0ab1fd6704740fafULL, 0x0d573fb1d34b3c97ULL,
+     0x0ba96f34ff0e7360ULL, 0x0f0022b38e14614cULL, 0x1f7668b085a4a783ULL, 0x05264651c3c38677ULL},
+    {0x0000000000000001ULL, 0x014a2b2ef7b73ea6ULL, 0x089eb451d7a475bcULL, 0x082a3f81abb73ba0ULL,
+     0x07aaf5a26322a044ULL, 0x1e2f3746edad887eULL, 0x03c67b9614ea2462ULL, 0x07c34c6b9105fe61ULL,
+     0x191f2783d4a34e23ULL, 0x04c53c944ab1405fULL, 0x0af45a92cc8e19edULL, 0x16861b97b978faf3ULL,
+     0x171840f53aceee84ULL, 0x0ed586507a2b746dULL, 0x13dc20bef3791388ULL, 0x1a3b9b7d04d0eaf0ULL},
+    {0x0000000000000001ULL, 0x07c24f7b4ce1f4b0ULL, 0x09de5082f551ae77ULL, 0x1e2a2284c99fedfeULL,
+     0x168418a331ce9d51ULL, 0x012dcc086b1bd06dULL, 0x02b8a5c6169dbd8aULL, 0x13480c671ec76eb2ULL,
+     0x0bac074c4ad77f7cULL, 0x062d831f4fd615c4ULL, 0x1318205c31f9a183ULL, 0x19fb67149e109907ULL,
+     0x12efd16c43386f8bULL, 0x1c0defbea1a39096ULL, 0x164d4d7d49ff6c0dULL, 0x1269d0791bc8636fULL},
+    {0x0000000000000001ULL, 0x09afa68dfb070ef2ULL, 0x1919b7ed4f1c74bcULL, 0x0ce81f753cce023aULL,
+     0x1a6fc35c15ec159eULL, 0x0167b0ab7ab45526ULL, 0x059df736f5d5f544ULL, 0x0b73a4d140c2d70eULL,
+     0x1959f6a164465aa6ULL, 0x0cf0b795317c1c80ULL, 0x0d722bfbe8b54c83ULL, 0x0d797ab7bdf1303cULL,
+     0x00045400a41b2ba8ULL, 0x0eb9dd0aa04af7a7ULL, 0x00bc37e9734e212bULL, 0x03938033691b241cULL},
+    {0x0000000000000001ULL, 0x057da53ade216c54ULL, 0x10808b4761f8518cULL, 0x0f1b5f4b32c4d5e2ULL,
+     0x1a4bf1f62c76bb01ULL, 0x08b8127b3f593ebeULL, 0x00f24a10e7073e58ULL, 0x0739e9d937c46fafULL,
+     0x04326cb2a54335f8ULL, 0x0a920c9dd672c094ULL, 0x0fc23aa4672e38a8ULL, 0x1cdd52dd96d9a702ULL,
+     0x1fd7e8383313413dULL, 0x01020cf4edf8741eULL, 0x1a07a28531d6d4e4ULL, 0x0523d3510e4bcd23ULL},
+    {0x0000000000000001ULL, 0x071cecb8c3ffa09eULL, 0x0dce62c803ca2cefULL, 0x142f00898190b428ULL,
+     0x12f471840e42100bULL, 0x1be76548e040535cULL, 0x01deffe0f1ac0f63ULL, 0x16ce1a14f4ed9675ULL,
+     0x1347d71ebb3fe7a2ULL, 0x04812513bc1d6a62ULL, 0x1ac321f5504ba3fcULL, 0x1439ee1d21c6d68bULL,
+     0x0db791e17237ed79ULL, 0x0e71191a27210cdfULL, 0x02919ce3a8e98f07ULL, 0x166bb46fd4bb7e08ULL},
+    {0x0000000000000001ULL, 0x167cc30f3c31a2d6ULL, 0x1127d9a95b580056ULL, 0x06000af9249e8993ULL,
+     0x1ac074eda580aae7ULL, 0x048f8cd59fa7252fULL, 0x098418f2e4e168a5ULL, 0x00dfef41d6a70b68ULL,
+     0x12fa282e1b0c8eefULL, 0x036b4839c1c1721fULL, 0x0388bcb273b814d8ULL, 0x17c37f4ea616d630ULL,
+     0x116780298ce313d3ULL, 0x126f83a0e7dd7b4cULL, 0x1b51cdf764b1d043ULL, 0x1061ab6bf7f9ca42ULL},
+    {0x0000000000000001ULL, 0x1a16c570017e4e34ULL, 0x0917c177b9afa1beULL, 0x047899b8f041eebbULL,
+     0x0891995d2a30303fULL, 0x0fee79d2b6f7d7f4ULL, 0x178e505bc3254d0eULL, 0x01575a5a5b7dfa12ULL,
+     0x014b97d41d220f00ULL, 0x19a0d81b4e5172e8ULL, 0x0526cebcd8b4b4e9ULL, 0x152a8b698a354377ULL,
+     0x124e6d3491f2cd71ULL, 0x149a917cdce6563fULL, 0x0565ae88e601c7adULL, 0x02d0523f4ef6fabeULL},
+    {0x0000000000000001ULL, 0x1b78fffdc15b0189ULL, 0x1b0048f8ceb82e4cULL, 0x08ac2815101bcd10ULL,
+     0x0499dd6968dd6577ULL, 0x08561f3c989d69bbULL, 0x0581d38082526887ULL, 0x07ce4827c87ca014ULL,
+     0x12a8aeb49dd88f74ULL, 0x0a77c64774c1da55ULL, 0x00301f673b89cbffULL, 0x05882eb9fe646436ULL,
+     0x0c0f7e7f17e72af9ULL, 0x01522413658d4a46ULL, 0x071e6e35c21803ccULL, 0x1167d696b39574b9ULL},
+    {0x0000000000000001ULL, 0x1fffffffffffffdaULL, 0x0000000000000559ULL, 0x1fffffffffff3a22ULL,
+     0x00000000001c98f1ULL, 0x1ffffffffbdde52aULL, 0x0000000098ede0c9ULL, 0x1fffffe9e59e82f2ULL,
+     0x00000331d01712e1ULL, 0x1fff89ccecaa457aULL, 0x00111561cb63f539ULL, 0x1d87e8dd9a8d8ec2ULL,
+     0x1b5b57f8a98a5dd3ULL, 0x0bcc490f7f007061ULL, 0x0b7970c2a4efc1edULL, 0x1772b3de2958f8b1ULL}
+};
 
-        // ~46.875% success rate. Bound on k^7 needed for efficient reduction.
-        p->k = polymur_extrared611(k);
-        p->k2 = polymur_extrared611(polymur_red611(polymur_mul128(p->k,  p->k)));
-        uint64_t k3 =               polymur_red611(polymur_mul128(p->k,  p->k2));
-        uint64_t k4 =               polymur_red611(polymur_mul128(p->k2, p->k2));
-        p->k7 = polymur_extrared611(polymur_red611(polymur_mul128(k3, k4)));
-        if (p->k7 < (1ULL << 60) - (1ULL << 56)) break;
-        // Our key space is log2(totient(2^61 - 2) * (2^60-2^56)/2^61) ~= 57.4 bits.
+// Computes 37^e mod 2^61 - 1 for e < 2^64. Every intermediate product of
+// canonical residues, and thus the result, is the canonical residue, so this
+// gives exactly the key polymur_init_params computes for the same exponent.
+static inline uint64_t polymur_init_pow37(uint64_t e) {
+    uint64_t ka = 1, kb = 1;
+    for (int i = 0; i < 16; i += 2) {
+        ka = polymur_extrared611(polymur_red611(polymur_mul128(ka, POLYMUR_POW37_WINDOW[i  ][(e >> (4*i    )) & 15])));
+        kb = polymur_extrared611(polymur_red611(polymur_mul128(kb, POLYMUR_POW37_WINDOW[i+1][(e >> (4*i + 4)) & 15])));
     }
+    return polymur_extrared611(polymur_red611(polymur_mul128(ka, kb)));
+}
+
+static inline void polymur_init_params_fast(PolymurHashParams* p, uint64_t k_seed, uint64_t s_seed) {
+    p->s = s_seed ^ POLYMUR_ARBITRARY1;
+    while (!polymur_init_key(p, polymur_init_pow37(polymur_init_exponent(&k_seed)), 1));
 }
 
 static inline void polymur_init_params_from_seed(PolymurHashParams* p, uint64_t seed) {
     polymur_init_params(p, polymur_mix(seed + POLYMUR_ARBITRARY3), polymur_mix(seed + POLYMUR_ARBITRARY4));
 }
 
-static inline uint64_t polymur_hash_poly611(const uint8_t* buf, size_t len, const PolymurHashParams* p, uint64_t tweak) {
+#define POLYMUR_INIT_LANES 4
+
+static inline void polymur_init_params_many(PolymurHashParams* p, size_t n, uint64_t seed) {
+    // Expanding one seed is a short chain of dependent multiplications ended
+    // by an unpredictable accept/reject branch. We expand POLYMUR_INIT_LANES
+    // seeds side by side, refilling a lane with the next seed as soon as its
+    // key is accepted, so the chains overlap.
+    uint64_t k_seed[POLYMUR_INIT_LANES], k[POLYMUR_INIT_LANES];
+    size_t out[POLYMUR_INIT_LANES];
+    size_t next = 0, nlive;
+    for (int l = 0; l < POLYMUR_INIT_LANES; ++l) out[l] = n;
+
+    do {
+        nlive = 0;
+        for (int l = 0; l < POLYMUR_INIT_LANES; ++l) {
+            if (out[l] == n && next < n) {
+                out[l] = next++;
+                k_seed[l] = polymur_mix(seed + out[l] + POLYMUR_ARBITRARY3);
+                p[out[l]].s = polymur_mix(seed + out[l] + POLYMUR_ARBITRARY4) ^ POLYMUR_ARBITRARY1;
+            }
+            nlive += out[l] < n;
+        }
+        for (int l = 0; l < POLYMUR_INIT_LANES; ++l) {
+            k[l] = out[l] < n ? polymur_init_pow37(polymur_init_exponent(&k_seed[l])) : 1;
+        }
+        for (int l = 0; l < POLYMUR_INIT_LANES; ++l) {
+            if (out[l] < n && polymur_init_key(&p[out[l]], k[l], 1)) out[l] = n;
+        }
+    } while (nlive);
+}
+
+// Absorbs the 49-byte block at buf into the block accumulator h. Reads one
+// byte past the block. The powers k3 through k6 must be extra-reduced.
+static inline uint64_t polymur_poly611_block(const uint8_t* buf, uint64_t h, const PolymurHashParams* p,
+                                             uint64_t k3, uint64_t k4, uint64_t k5, uint64_t k6) {
+    // Written out rather than as a loop over an array, as not all compilers
+    // unroll it at -O2 and instead round-trip m[] through the stack, costing
+    // about a quarter of the throughput for long inputs.
+    const uint64_t m0 = polymur_load_le_u64(buf     ) & 0x00ffffffffffffffULL;
+    const uint64_t m1 = polymur_load_le_u64(buf +  7) & 0x00ffffffffffffffULL;
+    const uint64_t m2 = polymur_load_le_u64(buf + 14) & 0x00ffffffffffffffULL;
+    const uint64_t m3 = polymur_load_le_u64(buf + 21) & 0x00ffffffffffffffULL;
+    const uint64_t m4 = polymur_load_le_u64(buf + 28) & 0x00ffffffffffffffULL;
+    const uint64_t m5 = polymur_load_le_u64(buf + 35) & 0x00ffffffffffffffULL;
+    const uint64_t m6 = polymur_load_le_u64(buf + 42) & 0x00ffffffffffffffULL;
+    polymur_u128_t t0 = polymur_mul128(p->k  + m0, k6 + m1);
+    polymur_u128_t t1 = polymur_mul128(p->k2 + m2, k5 + m3);
+    polymur_u128_t t2 = polymur_mul128(   k3 + m4, k4 + m5);
+    polymur_u128_t t3 = polymur_mul128(   h  + m6, p->k7);
+    polymur_u128_t  s = polymur_add128(polymur_add128(t0, t1), polymur_add128(t2, t3));
+    return polymur_red611(s);
+}
+
+// The extra-reduced powers k3 through k6 for polymur_poly611_block.
+static inline void polymur_poly611_powers(const PolymurHashParams* p, uint64_t* k3, uint64_t* k4, uint64_t* k5, uint64_t* k6) {
+    uint64_t k4r = polymur_red611(polymur_mul128(p->k2, p->k2));
+    *k3 = polymur_extrared611(polymur_red611(polymur_mul128(p->k, p->k2)));
+    *k4 = polymur_extrared611(k4r);
+    *k5 = polymur_extrared611(polymur_red611(polymur_mul128(p->k,  k4r)));
+    *k6 = polymur_extrared611(polymur_red611(polymur_mul128(p->k2, k4r)));
+}
+
+// Multiplies the block accumulator by k^14 to make room for the final block.
+static inline uint64_t polymur_poly611_blocks_done(uint64_t h, const PolymurHashParams* p) {
+    const uint64_t k14 = polymur_red611(polymur_mul128(p->k7, p->k7));
+    uint64_t hk14 = polymur_red611(polymur_mul128(polymur_extrared611(h), k14));
+    return polymur_extrared611(hk14);
+}
+
+// Adds the final block of 0 to 49 bytes to poly_acc. The powers k3 and k4 must
+// be extra-reduced if and only if any full blocks preceded this one.
+static inline uint64_t polymur_poly611_tail(const uint8_t* buf, size_t len, const PolymurHashParams* p,
+                                            uint64_t k3, uint64_t k4, uint64_t poly_acc) {
     uint64_t m[7];
+    if (POLYMUR_LIKELY(len >= 8)) {
+        m[0] = polymur_load_le_u64(buf) & 0x00ffffffffffffffULL;
+        m[1] = polymur_load_le_u64(buf + (len - 7) / 2) & 0x00ffffffffffffffULL;
+        m[2] = polymur_load_le_u64(buf + len - 8) >> 8;
+        polymur_u128_t t0 = polymur_mul128(p->k2 + m[0], p->k7 + m[1]);
+        polymur_u128_t t1 = polymur_mul128(p->k  + m[2],    k3 + len);
+        if (POLYMUR_LIKELY(len <= 21)) return poly_acc + polymur_red611(polymur_add128(t0, t1));
+        m[3] = polymur_load_le_u64(buf +  7) & 0x00ffffffffffffffULL;
+        m[4] = polymur_load_le_u64(buf + 14) & 0x00ffffffffffffffULL;
+        m[5] = polymur_load_le_u64(buf + len - 21) & 0x00ffffffffffffffULL;
+        m[6] = polymur_load_le_u64(buf + len - 14) & 0x00ffffffffffffffULL;
+        uint64_t t0r = polymur_red611(t0);
+        polymur_u128_t t2 = polymur_mul128(p->k2 + m[3], p->k7 + m[4]);
+        polymur_u128_t t3 = polymur_mul128(  t0r + m[5],    k4 + m[6]);
+        polymur_u128_t s = polymur_add128(polymur_add128(t1, t2), t3);
+        return poly_acc + polymur_red611(s);
+    }
+
+    m[0] = polymur_load_le_u64_0_8(buf, len);
+    return poly_acc + polymur_red611(polymur_mul128(p->k + m[0], p->k2 + len));
+}
+
+#ifdef POLYMUR_HAS_AVX512IFMA
+// Below this many bytes the lane setup and joining cost more than they save.
+#ifndef POLYMUR_AVX512_MIN_LEN
+#define POLYMUR_AVX512_MIN_LEN 4096
+#endif
+
+// Returns the block accumulator of 8 * s blocks fully reduced, where lane j
+// runs the block loop over blocks j * s to (j + 1) * s - 1. The lanes are
+// joined as a polynomial in k^(7s). Reads one byte past the last block.
+static inline POLYMUR_AVX512_TARGET uint64_t polymur_poly611_blocks_avx512(const uint8_t* buf, size_t s, const PolymurHashParams* p,
+                                                                         uint64_t k3, uint64_t k4, uint64_t k5, uint64_t k6) {
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i m56 = _mm512_set1_epi64(0x00ffffffffffffffULL);
+    const __m512i p611 = _mm512_set1_epi64(POLYMUR_P611);
+    const __m512i vk = _mm512_set1_epi64(p->k), vk2 = _mm512_set1_epi64(p->k2), vk7 = _mm512_set1_epi64(p->k7);
+    const __m512i vk3 = _mm512_set1_epi64(k3), vk4 = _mm512_set1_epi64(k4);
+    const __m512i vk5 = _mm512_set1_epi64(k5), vk6 = _mm512_set1_epi64(k6);
+    const long long st = (long long) (49 * s);
+    const __m512i idx = _mm512_set_epi64(7 * st, 6 * st, 5 * st, 4 * st, 3 * st, 2 * st, st, 0);
+    __m512i h = zero;
+    for (size_t b = 0; b < s; ++b) {
+        const uint8_t* q = buf + 49 * b;
+        __m512i m0 = _mm512_and_si512(POLYMUR_AVX512_GATHER(idx, q     ), m56);
+        __m512i m1 = _mm512_and_si512(POLYMUR_AVX512_GATHER(idx, q +  7), m56);
+        __m512i m2 = _mm512_and_si512(POLYMUR_AVX512_GATHER(idx, q + 14), m56);
+        __m512i m3 = _mm512_and_si512(POLYMUR_AVX512_GATHER(idx, q + 21), m56);
+        __m512i m4 = _mm512_and_si512(POLYMUR_AVX512_GATHER(idx, q + 28), m56);
+        __m512i m5 = _mm512_and_si512(POLYMUR_AVX512_GATHER(idx, q + 35), m56);
+        __m512i m6 = _mm512_and_si512(POLYMUR_AVX512_GATHER(idx, q + 42), m56);
+        __m512i c0 = zero, c1 = zero, c2 = zero;
+        polymur_avx512_mul_acc(_mm512_add_epi64( vk, m0), _mm512_add_epi64(vk6, m1), &c0, &c1, &c2);
+        polymur_avx512_mul_acc(_mm512_add_epi64(vk2, m2), _mm512_add_epi64(vk5, m3), &c0, &c1, &c2);
+        polymur_avx512_mul_acc(_mm512_add_epi64(vk3, m4), _mm512_add_epi64(vk4, m5), &c0, &c1, &c2);
+        polymur_avx512_mul_acc(_mm512_add_epi64(  h, m6), vk7, &c0, &c1, &c2);
+
+        // Extra reduction keeps the sum of products below 2^125 for red611.
+        h = polymur_avx512_red611(c0, c1, c2);
+        h = _mm512_add_epi64(_mm512_and_si512(h, p611), POLYMUR_AVX512_SRLI(h, 61));
+    }
+
+    uint64_t lanes[8];
+    _mm512_storeu_si512((void*) lanes, h);
+    const uint64_t k7s = polymur_powmod611(p->k7, s);
+    uint64_t r = polymur_canon611(lanes[0]);
+    for (int j = 1; j < 8; ++j) r = polymur_canon611(polymur_mulmod611(r, k7s) + lanes[j]);
+    return r;
+}
+#endif
+
+static inline uint64_t polymur_hash_poly611(const uint8_t* buf, size_t len, const PolymurHashParams* p, uint64_t tweak) {
     uint64_t poly_acc = tweak;
 
     if (POLYMUR_LIKELY(len <= 7)) {
-        m[0] = polymur_load_le_u64_0_8(buf, len);
-        return poly_acc + polymur_red611(polymur_mul128(p->k + m[0], p->k2 + len));
+        uint64_t m0 = polymur_load_le_u64_0_8(buf, len);
+        return poly_acc + polymur_red611(polymur_mul128(p->k + m0, p->k2 + len));
     }
     
     uint64_t k3 = polymur_red611(polymur_mul128( p->k, p->k2));
@@ -245,49 +716,569 @@ static inline uint64_t polymur_hash_poly611(const uint8_t* buf, size_t len, cons
         k3 = polymur_extrared611(k3);
         k4 = polymur_extrared611(k4);
         uint64_t h = 0;
+        #ifdef POLYMUR_HAS_AVX512IFMA
+            // The lanes only give h mod 2^61 - 1. As in polymur_digest_finalize
+            // that determines polymur_poly611_blocks_done exactly, unless the
+            // residue of h * k^14 is below 8. Then the serial loop starts over.
+            if (len >= POLYMUR_AVX512_MIN_LEN && polymur_cpu_has_avx512ifma()) {
+                size_t s = (len - 1) / (8 * 49);
+                const uint8_t* rest = buf + 8 * 49 * s;
+                size_t rest_len = len - 8 * 49 * s;
+                h = polymur_poly611_blocks_avx512(buf, s, p, k3, k4, k5, k6);
+                for (; rest_len >= 50; rest_len -= 49, rest += 49) h = polymur_poly611_block(rest, h, p, k3, k4, k5, k6);
+                uint64_t hk14 = polymur_poly611_blocks_done(h, p);
+                if (POLYMUR_LIKELY(polymur_canon611(hk14) >= 8)) return polymur_poly611_tail(rest, rest_len, p, k3, k4, poly_acc + hk14);
+                h = 0;
+            }
+        #endif
         do {
-            for (int i = 0; i < 7; ++i) m[i] = polymur_load_le_u64(buf + 7*i) & 0x00ffffffffffffffULL;
-            polymur_u128_t t0 = polymur_mul128(p->k  + m[0], k6 + m[1]);
-            polymur_u128_t t1 = polymur_mul128(p->k2 + m[2], k5 + m[3]);
-            polymur_u128_t t2 = polymur_mul128(   k3 + m[4], k4 + m[5]);
-            polymur_u128_t t3 = polymur_mul128(   h  + m[6], p->k7);
-            polymur_u128_t  s = polymur_add128(polymur_add128(t0, t1), polymur_add128(t2, t3));
-            h = polymur_red611(s);
+            h = polymur_poly611_block(buf, h, p, k3, k4, k5, k6);
             len -= 49;
             buf += 49;
         } while (len >= 50);
-        const uint64_t k14 = polymur_red611(polymur_mul128(p->k7, p->k7));
-        uint64_t hk14 = polymur_red611(polymur_mul128(polymur_extrared611(h), k14));
-        poly_acc += polymur_extrared611(hk14);
+        poly_acc += polymur_poly611_blocks_done(h, p);
     }
     
-    if (POLYMUR_LIKELY(len >= 8)) {
-        m[0] = polymur_load_le_u64(buf) & 0x00ffffffffffffffULL;
-        m[1] = polymur_load_le_u64(buf + (len - 7) / 2) & 0x00ffffffffffffffULL;
-        m[2] = polymur_load_le_u64(buf + len - 8) >> 8;
-        polymur_u128_t t0 = polymur_mul128(p->k2 + m[0], p->k7 + m[1]);
-        polymur_u128_t t1 = polymur_mul128(p->k  + m[2],    k3 + len);
-        if (POLYMUR_LIKELY(len <= 21)) return poly_acc + polymur_red611(polymur_add128(t0, t1));
-        m[3] = polymur_load_le_u64(buf +  7) & 0x00ffffffffffffffULL;
-        m[4] = polymur_load_le_u64(buf + 14) & 0x00ffffffffffffffULL;
-        m[5] = polymur_load_le_u64(buf + len - 21) & 0x00ffffffffffffffULL;
-        m[6] = polymur_load_le_u64(buf + len - 14) & 0x00ffffffffffffffULL;
-        uint64_t t0r = polymur_red611(t0);
-        polymur_u128_t t2 = polymur_mul128(p->k2 + m[3], p->k7 + m[4]);
-        polymur_u128_t t3 = polymur_mul128(  t0r + m[5],    k4 + m[6]);
-        polymur_u128_t s = polymur_add128(polymur_add128(t1, t2), t3);
-        return poly_acc + polymur_red611(s);
+    return polymur_poly611_tail(buf, len, p, k3, k4, poly_acc);
+}
+
+#ifdef POLYMUR_INSTRUMENT
+// ---------- Instrumentation ----------
+#ifndef POLYMUR_INSTRUMENT_SAMPLE
+    #define POLYMUR_INSTRUMENT_SAMPLE 256 // Must be a power of two.
+#endif
+
+// Every thread registers its counters once in a list shared by all
+// translation units, through a weak (or selectany) head pointer. Nodes are
+// only ever prepended, so readers can walk the list without locks. Counters
+// are only written by their own thread, with relaxed atomic stores.
+typedef struct PolymurStatsNode {
+    PolymurStats stats;
+    struct PolymurStatsNode* next;
+} PolymurStatsNode;
+
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((weak)) PolymurStatsNode* polymur_stats_head = NULL;
+    #define POLYMUR_TLS __thread
+    #define POLYMUR_LOAD_PTR(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+    #define POLYMUR_CAS_PTR(p, expected, desired) \
+        __atomic_compare_exchange_n(p, &(expected), desired, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED)
+    #define POLYMUR_LOAD64(p) __atomic_load_n(p, __ATOMIC_RELAXED)
+    #define POLYMUR_STORE64(p, v) __atomic_store_n(p, v, __ATOMIC_RELAXED)
+    // Keeps the hash computation between the two cycle counter reads.
+    #define POLYMUR_OPAQUE(x) __asm__ volatile("" : : "r"(x) : "memory")
+#elif defined(_MSC_VER)
+    __declspec(selectany) PolymurStatsNode* polymur_stats_head = NULL;
+    #define POLYMUR_TLS __declspec(thread)
+    #define POLYMUR_LOAD_PTR(p) (*(PolymurStatsNode* volatile*) (p))
+    #define POLYMUR_CAS_PTR(p, expected, desired) \
+        ((expected) = (PolymurStatsNode*) _InterlockedCompareExchangePointer((void* volatile*) (p), desired, expected), \
+         (expected) == (desired)->next)
+    #define POLYMUR_LOAD64(p) (*(volatile uint64_t*) (p))
+    #define POLYMUR_STORE64(p, v) (*(volatile uint64_t*) (p) = (v))
+    #define POLYMUR_OPAQUE(x) _ReadWriteBarrier()
+#else
+    #error "POLYMUR_INSTRUMENT requires GCC, Clang or MSVC"
+#endif
+
+static inline uint64_t polymur_stats_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    return __rdtsc();
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+    uint64_t t;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(t));
+    return t;
+#else
+    return 0;
+#endif
+}
+
+static inline PolymurStatsNode* polymur_stats_node(void) {
+    static POLYMUR_TLS PolymurStatsNode* node;
+    if (POLYMUR_LIKELY(node != NULL)) return node;
+
+    // Without memory the calls of this thread are counted but never reported.
+    static POLYMUR_TLS PolymurStatsNode unregistered;
+    PolymurStatsNode* n = (PolymurStatsNode*) calloc(1, sizeof(PolymurStatsNode));
+    if (!n) return node = &unregistered;
+    PolymurStatsNode* head = POLYMUR_LOAD_PTR(&polymur_stats_head);
+    do {
+        n->next = head;
+    } while (!POLYMUR_CAS_PTR(&polymur_stats_head, head, n));
+    return node = n;
+}
+
+static inline void polymur_stats_snapshot(PolymurStats* out) {
+    memset(out, 0, sizeof(*out));
+    for (PolymurStatsNode* n = POLYMUR_LOAD_PTR(&polymur_stats_head); n; n = n->next) {
+        for (int c = 0; c < POLYMUR_STATS_CLASSES; ++c) {
+            out->calls[c] += POLYMUR_LOAD64(&n->stats.calls[c]);
+            out->bytes[c] += POLYMUR_LOAD64(&n->stats.bytes[c]);
+            out->sampled_calls[c] += POLYMUR_LOAD64(&n->stats.sampled_calls[c]);
+            out->sampled_ticks[c] += POLYMUR_LOAD64(&n->stats.sampled_ticks[c]);
+        }
     }
+}
 
-    m[0] = polymur_load_le_u64_0_8(buf, len);
-    return poly_acc + polymur_red611(polymur_mul128(p->k + m[0], p->k2 + len));
+static inline uint64_t polymur_hash_instrumented(const uint8_t* buf, size_t len, const PolymurHashParams* p, uint64_t tweak) {
+    PolymurStats* s = &polymur_stats_node()->stats;
+    int c = (len >= 8) + (len >= 50);
+    uint64_t calls = s->calls[c];
+    POLYMUR_STORE64(&s->calls[c], calls + 1);
+    POLYMUR_STORE64(&s->bytes[c], s->bytes[c] + len);
+    if (POLYMUR_LIKELY(calls & (POLYMUR_INSTRUMENT_SAMPLE - 1))) {
+        uint64_t h = polymur_hash_poly611(buf, len, p, tweak);
+        return polymur_mix(h) + p->s;
+    }
+
+    uint64_t t0 = polymur_stats_ticks();
+    POLYMUR_OPAQUE(t0);
+    uint64_t h = polymur_mix(polymur_hash_poly611(buf, len, p, tweak)) + p->s;
+    POLYMUR_OPAQUE(h);
+    uint64_t t1 = polymur_stats_ticks();
+    POLYMUR_STORE64(&s->sampled_calls[c], s->sampled_calls[c] + 1);
+    POLYMUR_STORE64(&s->sampled_ticks[c], s->sampled_ticks[c] + (t1 - t0));
+    return h;
 }
+#endif
 
 static inline uint64_t polymur_hash(const uint8_t* buf, size_t len, const PolymurHashParams* p, uint64_t tweak) {
+#ifdef POLYMUR_INSTRUMENT
+    return polymur_hash_instrumented(buf, len, p, tweak);
+#else
     uint64_t h = polymur_hash_poly611(buf, len, p, tweak);
     return polymur_mix(h) + p->s;
+#endif
+}
+
+static inline void polymur_hash_init(PolymurHashState* st, const PolymurHashParams* p, uint64_t tweak) {
+    st->p = p;
+    st->k3 = polymur_red611(polymur_mul128( p->k, p->k2));
+    st->k4 = polymur_red611(polymur_mul128(p->k2, p->k2));
+    st->k5 = polymur_extrared611(polymur_red611(polymur_mul128(p->k,  st->k4)));
+    st->k6 = polymur_extrared611(polymur_red611(polymur_mul128(p->k2, st->k4)));
+    st->h = 0;
+    st->tweak = tweak;
+    st->nblocks = 0;
+    st->buf_len = 0;
+}
+
+static inline void polymur_hash_update(PolymurHashState* st, const uint8_t* buf, size_t len) {
+    // A block can only be absorbed once we know more input follows it, as the
+    // final 1 to 49 bytes are always hashed as the tail.
+    if (st->buf_len + len <= 49) {
+        if (len) memcpy(st->buf + st->buf_len, buf, len);
+        st->buf_len += len;
+        return;
+    }
+
+    const uint64_t k3 = polymur_extrared611(st->k3);
+    const uint64_t k4 = polymur_extrared611(st->k4);
+    uint64_t h = st->h;
+    if (st->buf_len) {
+        size_t fill = 49 - st->buf_len;
+        memcpy(st->buf + st->buf_len, buf, fill);
+        h = polymur_poly611_block(st->buf, h, st->p, k3, k4, st->k5, st->k6);
+        st->nblocks += 1;
+        buf += fill;
+        len -= fill;
+    }
+
+    while (len >= 50) {
+        h = polymur_poly611_block(buf, h, st->p, k3, k4, st->k5, st->k6);
+        st->nblocks += 1;
+        len -= 49;
+        buf += 49;
+    }
+
+    memcpy(st->buf, buf, len);
+    st->buf_len = len;
+    st->h = h;
+}
+
+static inline uint64_t polymur_hash_finalize(const PolymurHashState* st) {
+    const PolymurHashParams* p = st->p;
+    uint64_t poly_acc = st->tweak;
+    uint64_t k3 = st->k3;
+    uint64_t k4 = st->k4;
+    if (st->nblocks) {
+        poly_acc += polymur_poly611_blocks_done(st->h, p);
+        k3 = polymur_extrared611(k3);
+        k4 = polymur_extrared611(k4);
+    }
+    uint64_t h = polymur_poly611_tail(st->buf, st->buf_len, p, k3, k4, poly_acc);
+    return polymur_mix(h) + p->s;
+}
+
+#define POLYMUR_BATCH_CHUNK 64
+#define POLYMUR_BATCH_CLASSES 6
+
+// Powers of k shared by all keys of a batch. Keys without full blocks use k3
+// and k4 as they are, keys with blocks the extra-reduced k3x through k6.
+typedef struct {
+    uint64_t k3, k4, k3x, k4x, k5, k6;
+} PolymurBatchPowers;
+
+static inline void polymur_batch_powers(const PolymurHashParams* p, PolymurBatchPowers* kp) {
+    kp->k3 = polymur_red611(polymur_mul128( p->k, p->k2));
+    kp->k4 = polymur_red611(polymur_mul128(p->k2, p->k2));
+    polymur_poly611_powers(p, &kp->k3x, &kp->k4x, &kp->k5, &kp->k6);
+}
+
+// Computes polymur_hash_poly611 for w <= POLYMUR_BATCH_CHUNK keys, where acc[j]
+// holds the tweak for key j and is replaced by its result. The keys are first
+// grouped by length class, so the branches in the hash loops below are
+// predictable for mixed lengths. Hashing keys in lockstep, two at a time,
+// was measured to be no faster, as the out-of-order core already overlaps the
+// multiply chains of consecutive keys.
+static inline void polymur_poly611_chunk(const uint8_t* const* keys, const size_t* lens, size_t w,
+                                         const PolymurHashParams* p, const PolymurBatchPowers* kp, uint64_t* acc) {
+    uint8_t idx[POLYMUR_BATCH_CLASSES][POLYMUR_BATCH_CHUNK];
+    size_t cnt[POLYMUR_BATCH_CLASSES] = {0, 0, 0, 0, 0, 0};
+    for (size_t j = 0; j < w; ++j) {
+        size_t len = lens[j];
+        size_t c = (len >= 1) + (len >= 4) + (len >= 8) + (len >= 22) + (len >= 50);
+        idx[c][cnt[c]++] = (uint8_t) j;
+    }
+
+    // The len <= 7 path of polymur_hash_poly611 equals that of the tail, and
+    // for len = 0 it adds red611(k * k2) = k3.
+    for (size_t t = 0; t < cnt[0]; ++t) acc[idx[0][t]] += kp->k3;
+    for (size_t c = 1; c <= 2; ++c) {
+        for (size_t t = 0; t < cnt[c]; ++t) {
+            size_t j = idx[c][t];
+            uint64_t m0 = polymur_load_le_u64_0_8(keys[j], lens[j]);
+            acc[j] += polymur_red611(polymur_mul128(p->k + m0, p->k2 + lens[j]));
+        }
+    }
+    for (size_t c = 3; c <= 4; ++c) {
+        for (size_t t = 0; t < cnt[c]; ++t) {
+            size_t j = idx[c][t];
+            acc[j] = polymur_poly611_tail(keys[j], lens[j], p, kp->k3, kp->k4, acc[j]);
+        }
+    }
+    for (size_t t = 0; t < cnt[5]; ++t) {
+        size_t j = idx[5][t];
+        const uint8_t* buf = keys[j];
+        size_t len = lens[j];
+        uint64_t h = 0;
+        do {
+            h = polymur_poly611_block(buf, h, p, kp->k3x, kp->k4x, kp->k5, kp->k6);
+            len -= 49;
+            buf += 49;
+        } while (len >= 50);
+        acc[j] = polymur_poly611_tail(buf, len, p, kp->k3x, kp->k4x, acc[j] + polymur_poly611_blocks_done(h, p));
+    }
+}
+
+static inline void polymur_hash_batch_prefetch(const uint8_t* const* keys, const size_t* lens, size_t n,
+                                               const PolymurHashParams* p, uint64_t tweak, uint64_t* out,
+                                               const void* buckets, size_t bucket_size, uint64_t bucket_mask) {
+    PolymurBatchPowers kp;
+    polymur_batch_powers(p, &kp);
+    for (size_t base = 0; base < n; base += POLYMUR_BATCH_CHUNK) {
+        size_t w = n - base < POLYMUR_BATCH_CHUNK ? n - base : POLYMUR_BATCH_CHUNK;
+        uint64_t* co = out + base;
+        for (size_t j = 0; j < w; ++j) co[j] = tweak;
+        polymur_poly611_chunk(keys + base, lens + base, w, p, &kp, co);
+        for (size_t j = 0; j < w; ++j) {
+            co[j] = polymur_mix(co[j]) + p->s;
+            if (buckets) POLYMUR_PREFETCH((const char*) buckets + (co[j] & bucket_mask) * bucket_size);
+        }
+    }
 }
 
+static inline void polymur_hash_batch(const uint8_t* const* keys, const size_t* lens, size_t n,
+                                      const PolymurHashParams* p, uint64_t tweak, uint64_t* out) {
+    polymur_hash_batch_prefetch(keys, lens, n, p, tweak, out, NULL, 0, 0);
+}
+
+#ifdef POLYMUR_HAS_AVX512IFMA
+// ---------- AVX-512 IFMA kernels ----------
+static inline POLYMUR_AVX512_TARGET __m512i polymur_avx512_mix(__m512i x) {
+    const __m512i c = _mm512_set1_epi64(0xe9846af9b1a615dULL);
+    x = _mm512_xor_si512(x, POLYMUR_AVX512_SRLI(x, 32));
+    x = _mm512_mullo_epi64(x, c);
+    x = _mm512_xor_si512(x, POLYMUR_AVX512_SRLI(x, 32));
+    x = _mm512_mullo_epi64(x, c);
+    return _mm512_xor_si512(x, POLYMUR_AVX512_SRLI(x, 28));
+}
+
+static inline POLYMUR_AVX512_TARGET size_t polymur_hash_u64_array_avx512(const uint64_t* keys, size_t n, const PolymurHashParams* p, uint64_t tweak, uint64_t* out) {
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i m56 = _mm512_set1_epi64(0x00ffffffffffffffULL);
+    const __m512i k = _mm512_set1_epi64(p->k), k2 = _mm512_set1_epi64(p->k2), k7 = _mm512_set1_epi64(p->k7);
+    const __m512i k3l = _mm512_set1_epi64(polymur_red611(polymur_mul128(p->k, p->k2)) + 8);
+    const __m512i vt = _mm512_set1_epi64(tweak), vs = _mm512_set1_epi64(p->s);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i v = _mm512_loadu_si512((const void*) (keys + i));
+        __m512i m0 = _mm512_and_si512(v, m56);
+        __m512i c0 = zero, c1 = zero, c2 = zero;
+        polymur_avx512_mul_acc(_mm512_add_epi64(k2, m0), _mm512_add_epi64(k7, m0), &c0, &c1, &c2);
+        polymur_avx512_mul_acc(_mm512_add_epi64(k, POLYMUR_AVX512_SRLI(v, 8)), k3l, &c0, &c1, &c2);
+        __m512i h = _mm512_add_epi64(vt, polymur_avx512_red611(c0, c1, c2));
+        _mm512_storeu_si512((void*) (out + i), _mm512_add_epi64(polymur_avx512_mix(h), vs));
+    }
+    return i;
+}
+
+static inline POLYMUR_AVX512_TARGET size_t polymur_hash_u32_array_avx512(const uint32_t* keys, size_t n, const PolymurHashParams* p, uint64_t tweak, uint64_t* out) {
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i k = _mm512_set1_epi64(p->k), k2l = _mm512_set1_epi64(p->k2 + 4);
+    const __m512i vt = _mm512_set1_epi64(tweak), vs = _mm512_set1_epi64(p->s);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i v = _mm512_maskz_cvtepu32_epi64((__mmask8) 0xff, _mm256_loadu_si256((const __m256i*) (keys + i)));
+        __m512i c0 = zero, c1 = zero, c2 = zero;
+        polymur_avx512_mul_acc(_mm512_add_epi64(k, v), k2l, &c0, &c1, &c2);
+        __m512i h = _mm512_add_epi64(vt, polymur_avx512_red611(c0, c1, c2));
+        _mm512_storeu_si512((void*) (out + i), _mm512_add_epi64(polymur_avx512_mix(h), vs));
+    }
+    return i;
+}
+#endif
+
+static inline void polymur_hash_u64_array(const uint64_t* keys, size_t n, const PolymurHashParams* p, uint64_t tweak, uint64_t* out) {
+    #ifdef POLYMUR_HAS_AVX512IFMA
+        if (n >= 8 && polymur_cpu_has_avx512ifma()) {
+            size_t done = polymur_hash_u64_array_avx512(keys, n, p, tweak, out);
+            keys += done; n -= done; out += done;
+        }
+    #endif
+
+    // The len 8..21 path of polymur_poly611_tail specialized to len = 8, where
+    // the first two loads coincide. Parameters are copied to locals as they
+    // could otherwise alias out.
+    const uint64_t k = p->k, k2 = p->k2, k7 = p->k7, s = p->s;
+    const uint64_t k3l = polymur_red611(polymur_mul128(k, k2)) + 8;
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t v = polymur_is_little_endian() ? keys[i] : polymur_bswap64(keys[i]);
+        uint64_t m0 = v & 0x00ffffffffffffffULL;
+        polymur_u128_t t0 = polymur_mul128(k2 + m0, k7 + m0);
+        polymur_u128_t t1 = polymur_mul128(k + (v >> 8), k3l);
+        out[i] = polymur_mix(tweak + polymur_red611(polymur_add128(t0, t1))) + s;
+    }
+}
+
+static inline void polymur_hash_u32_array(const uint32_t* keys, size_t n, const PolymurHashParams* p, uint64_t tweak, uint64_t* out) {
+    #ifdef POLYMUR_HAS_AVX512IFMA
+        if (n >= 8 && polymur_cpu_has_avx512ifma()) {
+            size_t done = polymur_hash_u32_array_avx512(keys, n, p, tweak, out);
+            keys += done; n -= done; out += done;
+        }
+    #endif
+
+    // For len = 4 both loads of polymur_load_le_u64_0_8 coincide.
+    const uint64_t k = p->k, k2l = p->k2 + 4, s = p->s;
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t v = polymur_is_little_endian() ? keys[i] : polymur_bswap32(keys[i]);
+        out[i] = polymur_mix(tweak + polymur_red611(polymur_mul128(k + v, k2l))) + s;
+    }
+}
+
+// ---------- Digests and parallel hashing ----------
+// The block loop is a Horner evaluation in k^7, so blocks can be hashed in
+// independent runs and joined by multiplying with powers of k^7. This only
+// gives the block polynomial mod 2^61 - 1, whereas polymur_hash depends on the
+// exact unreduced value of h. However, polymur_poly611_blocks_done returns a
+// value <= 2^61 + 6 congruent to h * k^14, which is thus always fully reduced
+// when that residue is >= 8. Otherwise, with probability 2^-58, the hash can
+// not be derived from the digest.
+
+// Returns the block accumulator of nblocks blocks, only correct mod 2^61 - 1.
+// Reads one byte past the last block.
+static inline uint64_t polymur_digest_run(const uint8_t* buf, size_t nblocks, const PolymurHashParams* p,
+                                          uint64_t k3, uint64_t k4, uint64_t k5, uint64_t k6) {
+    uint64_t h = 0;
+    #ifdef POLYMUR_HAS_AVX512IFMA
+        if (49 * nblocks >= POLYMUR_AVX512_MIN_LEN && polymur_cpu_has_avx512ifma()) {
+            size_t s = nblocks / 8;
+            h = polymur_poly611_blocks_avx512(buf, s, p, k3, k4, k5, k6);
+            buf += 8 * 49 * s;
+            nblocks -= 8 * s;
+        }
+    #endif
+    for (; nblocks; --nblocks, buf += 49) h = polymur_poly611_block(buf, h, p, k3, k4, k5, k6);
+    return h;
+}
+
+static inline void polymur_digest_blocks(PolymurDigest* d, const uint8_t* buf, size_t nblocks, const PolymurHashParams* p) {
+    uint64_t k3, k4, k5, k6;
+    polymur_poly611_powers(p, &k3, &k4, &k5, &k6);
+    uint64_t h = 0;
+    if (nblocks) {
+        h = polymur_digest_run(buf, nblocks - 1, p, k3, k4, k5, k6);
+        uint8_t last[56] = {0}; // polymur_poly611_block reads one byte past the block.
+        memcpy(last, buf + 49 * (nblocks - 1), 49);
+        h = polymur_poly611_block(last, h, p, k3, k4, k5, k6);
+    }
+    d->h = polymur_canon611(h);
+    d->nblocks = nblocks;
+}
+
+static inline PolymurDigest polymur_concat(const PolymurHashParams* p, PolymurDigest a, PolymurDigest b) {
+    PolymurDigest r;
+    r.h = polymur_canon611(polymur_mulmod611(a.h, polymur_powmod611(p->k7, b.nblocks)) + b.h);
+    r.nblocks = a.nblocks + b.nblocks;
+    return r;
+}
+
+static inline int polymur_digest_patch(PolymurDigest* d, uint64_t first, const uint8_t* old_blocks,
+                                       const uint8_t* new_blocks, size_t nblocks, const PolymurHashParams* p) {
+    if (first > d->nblocks || nblocks > d->nblocks - first) return 0;
+    PolymurDigest od, nd;
+    polymur_digest_blocks(&od, old_blocks, nblocks, p);
+    polymur_digest_blocks(&nd, new_blocks, nblocks, p);
+    uint64_t delta = polymur_canon611(nd.h + POLYMUR_P611 - od.h);
+    uint64_t shift = polymur_powmod611(p->k7, d->nblocks - first - nblocks);
+    d->h = polymur_canon611(d->h + polymur_mulmod611(delta, shift));
+    return 1;
+}
+
+static inline int polymur_digest_finalize(const PolymurDigest* d, const uint8_t* tail, size_t tail_len,
+                                          const PolymurHashParams* p, uint64_t tweak, uint64_t* out) {
+    if (!d->nblocks) {
+        *out = polymur_hash(tail, tail_len, p, tweak);
+        return 1;
+    }
+
+    uint64_t hk14 = polymur_mulmod611(d->h, polymur_red611(polymur_mul128(p->k7, p->k7)));
+    if (POLYMUR_UNLIKELY(hk14 < 8)) return 0;
+    uint64_t k3 = polymur_extrared611(polymur_red611(polymur_mul128( p->k, p->k2)));
+    uint64_t k4 = polymur_extrared611(polymur_red611(polymur_mul128(p->k2, p->k2)));
+    *out = polymur_mix(polymur_poly611_tail(tail, tail_len, p, k3, k4, tweak + hk14)) + p->s;
+    return 1;
+}
+
+#define POLYMUR_MAX_SEGMENTS 256
+#ifndef POLYMUR_MIN_SEGMENT_BLOCKS
+    #define POLYMUR_MIN_SEGMENT_BLOCKS 1024 // Keeps per-segment overhead negligible.
+#endif
+
+typedef struct {
+    const uint8_t* buf;
+    const PolymurHashParams* p;
+    uint64_t k3, k4, k5, k6;
+    size_t seg_blocks, nblocks;
+    PolymurDigest d[POLYMUR_MAX_SEGMENTS];
+} PolymurParallelJob;
+
+static inline void polymur_parallel_task(void* arg, size_t i) {
+    // Unlike polymur_digest_blocks this can read one byte past the last
+    // block, as it is always followed by the tail.
+    PolymurParallelJob* job = (PolymurParallelJob*) arg;
+    size_t begin = i * job->seg_blocks;
+    size_t end = begin + job->seg_blocks < job->nblocks ? begin + job->seg_blocks : job->nblocks;
+    uint64_t h = polymur_digest_run(job->buf + 49 * begin, end - begin, job->p, job->k3, job->k4, job->k5, job->k6);
+    job->d[i].h = polymur_canon611(h);
+    job->d[i].nblocks = end - begin;
+}
+
+static inline uint64_t polymur_hash_parallel(const uint8_t* buf, size_t len, const PolymurHashParams* p, uint64_t tweak,
+                                             size_t nsegments, polymur_executor_fn executor, void* ctx) {
+    size_t nblocks = len >= 50 ? (len - 1) / 49 : 0;
+    if (nsegments > POLYMUR_MAX_SEGMENTS) nsegments = POLYMUR_MAX_SEGMENTS;
+    if (nsegments > nblocks / POLYMUR_MIN_SEGMENT_BLOCKS) nsegments = nblocks / POLYMUR_MIN_SEGMENT_BLOCKS;
+    if (nsegments <= 1) return polymur_hash(buf, len, p, tweak);
+
+    PolymurParallelJob job;
+    job.buf = buf;
+    job.p = p;
+    polymur_poly611_powers(p, &job.k3, &job.k4, &job.k5, &job.k6);
+    job.seg_blocks = (nblocks + nsegments - 1) / nsegments;
+    job.nblocks = nblocks;
+    nsegments = (nblocks + job.seg_blocks - 1) / job.seg_blocks;
+    if (executor) executor(ctx, polymur_parallel_task, &job, nsegments);
+    else for (size_t i = 0; i < nsegments; ++i) polymur_parallel_task(&job, i);
+
+    PolymurDigest d = job.d[0];
+    for (size_t i = 1; i < nsegments; ++i) d = polymur_concat(p, d, job.d[i]);
+    uint64_t h;
+    if (POLYMUR_LIKELY(polymur_digest_finalize(&d, buf + 49 * nblocks, len - 49 * nblocks, p, tweak, &h))) return h;
+    return polymur_hash(buf, len, p, tweak);
+}
+
+// ---------- 128-bit hashing ----------
+static inline void polymur_init_params128(PolymurHashParams128* p, uint64_t ka_seed, uint64_t sa_seed,
+                                          uint64_t kb_seed, uint64_t sb_seed) {
+    polymur_init_params(&p->a, ka_seed, sa_seed);
+    polymur_init_params(&p->b, kb_seed, sb_seed);
+}
+
+static inline void polymur_init_params128_from_seed(PolymurHashParams128* p, uint64_t seed) {
+    polymur_init_params_from_seed(&p->a, seed);
+    polymur_init_params(&p->b, polymur_mix(seed + POLYMUR_ARBITRARY1), polymur_mix(seed + POLYMUR_ARBITRARY2));
+}
+
+static inline PolymurHash128 polymur_hash128(const uint8_t* buf, size_t len, const PolymurHashParams128* p, uint64_t tweak) {
+    // Two interleaved copies of polymur_hash_poly611. Both evaluate the same
+    // loads, which the compiler merges, and the two independent dependency
+    // chains fill each other's latency.
+    const PolymurHashParams* pa = &p->a;
+    const PolymurHashParams* pb = &p->b;
+    uint64_t acc_a = tweak, acc_b = tweak;
+    #ifdef POLYMUR_HAS_AVX512IFMA
+        // The AVX-512 block loop beats interleaving the scalar one, so long
+        // inputs are hashed once per key.
+        if (len >= POLYMUR_AVX512_MIN_LEN && polymur_cpu_has_avx512ifma()) {
+            acc_a = polymur_hash_poly611(buf, len, pa, tweak);
+            acc_b = polymur_hash_poly611(buf, len, pb, tweak);
+        } else
+    #endif
+    if (POLYMUR_LIKELY(len <= 7)) {
+        uint64_t m0 = polymur_load_le_u64_0_8(buf, len);
+        acc_a += polymur_red611(polymur_mul128(pa->k + m0, pa->k2 + len));
+        acc_b += polymur_red611(polymur_mul128(pb->k + m0, pb->k2 + len));
+    } else {
+        uint64_t k3a = polymur_red611(polymur_mul128( pa->k, pa->k2));
+        uint64_t k4a = polymur_red611(polymur_mul128(pa->k2, pa->k2));
+        uint64_t k3b = polymur_red611(polymur_mul128( pb->k, pb->k2));
+        uint64_t k4b = polymur_red611(polymur_mul128(pb->k2, pb->k2));
+        if (POLYMUR_UNLIKELY(len >= 50)) {
+            const uint64_t k5a = polymur_extrared611(polymur_red611(polymur_mul128(pa->k,  k4a)));
+            const uint64_t k6a = polymur_extrared611(polymur_red611(polymur_mul128(pa->k2, k4a)));
+            const uint64_t k5b = polymur_extrared611(polymur_red611(polymur_mul128(pb->k,  k4b)));
+            const uint64_t k6b = polymur_extrared611(polymur_red611(polymur_mul128(pb->k2, k4b)));
+            k3a = polymur_extrared611(k3a);
+            k4a = polymur_extrared611(k4a);
+            k3b = polymur_extrared611(k3b);
+            k4b = polymur_extrared611(k4b);
+            uint64_t ha = 0, hb = 0;
+            do {
+                ha = polymur_poly611_block(buf, ha, pa, k3a, k4a, k5a, k6a);
+                hb = polymur_poly611_block(buf, hb, pb, k3b, k4b, k5b, k6b);
+                len -= 49;
+                buf += 49;
+            } while (len >= 50);
+            acc_a += polymur_poly611_blocks_done(ha, pa);
+            acc_b += polymur_poly611_blocks_done(hb, pb);
+        }
+        acc_a = polymur_poly611_tail(buf, len, pa, k3a, k4a, acc_a);
+        acc_b = polymur_poly611_tail(buf, len, pb, k3b, k4b, acc_b);
+    }
+
+    PolymurHash128 r;
+    r.lo = polymur_mix(acc_a) + pa->s;
+    r.hi = polymur_mix(acc_b) + pb->s;
+    return r;
+}
+
+#ifdef POLYMUR_HAS_IOVEC
+static inline uint64_t polymur_hash_iov(const struct iovec* iov, int n, const PolymurHashParams* p, uint64_t tweak) {
+    if (n == 1) return polymur_hash((const uint8_t*) iov[0].iov_base, iov[0].iov_len, p, tweak);
+
+    // Blocks contained within a single buffer are hashed in-place, only those
+    // straddling a buffer boundary and the tail get copied on the stack.
+    PolymurHashState st;
+    polymur_hash_init(&st, p, tweak);
+    for (int i = 0; i < n; ++i) {
+        polymur_hash_update(&st, (const uint8_t*) iov[i].iov_base, iov[i].iov_len);
+    }
+    return polymur_hash_finalize(&st);
+}
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,286 @@
+/*
+    PolymurHash C++ interface, see polymur-hash.h for the license.
+
+    Requires C++17. Adds hashing of inputs whose length is known at compile
+    time, and constexpr hashing of strings, e.g. for switch tables:
+
+        constexpr polymur::Params P(0x123456789abcdefULL);
+        switch (polymur::hash(cmd, P)) {
+            case polymur::hash("get", P): ...
+            case polymur::hash("put", P): ...
+        }
+
+    All functions give exactly the same values as polymur_hash.
+
+    Also provides polymur::Hasher, a hash functor for hash tables, see
+    polymur-map.hpp for a flat hash map using it.
+*/
+
+#ifndef POLYMUR_HASH_HPP
+#define POLYMUR_HASH_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string_view>
+#include <type_traits>
+
+#include "polymur-hash.h"
+
+#if defined(__cpp_lib_is_constant_evaluated)
+    #define POLYMUR_IS_CONSTANT_EVALUATED() std::is_constant_evaluated()
+#elif defined(__has_builtin)
+    #if __has_builtin(__builtin_is_constant_evaluated)
+        #define POLYMUR_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+    #endif
+#endif
+
+namespace polymur {
+
+// ---------- Constexpr arithmetic ----------
+// Mirrors the integer arithmetic in polymur-hash.h, restricted to what can be
+// evaluated at compile time.
+namespace detail {
+    struct U128 {
+        uint64_t lo, hi;
+    };
+
+    constexpr U128 add128(U128 a, U128 b) {
+        a.lo += b.lo;
+        a.hi += b.hi + (a.lo < b.lo);
+        return a;
+    }
+
+    constexpr U128 mul128(uint64_t a, uint64_t b) {
+        uint64_t lo_lo = (a & 0xffffffffULL) * (b & 0xffffffffULL);
+        uint64_t hi_lo = (a >> 32)           * (b & 0xffffffffULL);
+        uint64_t lo_hi = (a & 0xffffffffULL) * (b >> 32);
+        uint64_t hi_hi = (a >> 32)           * (b >> 32);
+        uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffffULL) + lo_hi;
+        return U128{(cross << 32) | (lo_lo & 0xffffffffULL), (hi_lo >> 32) + (cross >> 32) + hi_hi};
+    }
+
+    constexpr uint64_t red611(U128 x) {
+        return (x.lo & POLYMUR_P611) + ((x.lo >> 61) | (x.hi << 3));
+    }
+
+    constexpr uint64_t extrared611(uint64_t x) {
+        return (x & POLYMUR_P611) + (x >> 61);
+    }
+
+    constexpr uint64_t mulred(uint64_t a, uint64_t b) {
+        return red611(mul128(a, b));
+    }
+
+    constexpr uint64_t mix(uint64_t x) {
+        x ^= x >> 32;
+        x *= 0xe9846af9b1a615dULL;
+        x ^= x >> 32;
+        x *= 0xe9846af9b1a615dULL;
+        x ^= x >> 28;
+        return x;
+    }
+
+    // Loads n <= 8 bytes as a little-endian integer. All the (possibly
+    // overlapping) loads in polymur-hash.h reduce to this.
+    constexpr uint64_t load_le(const char* buf, size_t n) {
+        uint64_t v = 0;
+        for (size_t i = 0; i < n; ++i) v |= uint64_t(uint8_t(buf[i])) << 8 * i;
+        return v;
+    }
+
+    // Same as polymur_init_params.
+    constexpr PolymurHashParams init_params(uint64_t k_seed, uint64_t s_seed) {
+        PolymurHashParams p{};
+        p.s = s_seed ^ POLYMUR_ARBITRARY1;
+
+        uint64_t pow37[64]{};
+        pow37[0] = 37; pow37[32] = 559096694736811184ULL;
+        for (int i = 0; i < 31; ++i) {
+            pow37[i+ 1] = extrared611(mulred(pow37[i],    pow37[i]));
+            pow37[i+33] = extrared611(mulred(pow37[i+32], pow37[i+32]));
+        }
+
+        while (true) {
+            k_seed += POLYMUR_ARBITRARY2;
+            uint64_t e = (k_seed >> 3) | 1;
+            if (e % 3 == 0) continue;
+            if (!(e % 5 && e % 7)) continue;
+            if (!(e % 11 && e % 13 && e % 31)) continue;
+            if (!(e % 41 && e % 61 && e % 151 && e % 331 && e % 1321)) continue;
+
+            uint64_t ka = 1, kb = 1;
+            for (int i = 0; e; i += 2, e >>= 2) {
+                if (e & 1) ka = extrared611(mulred(ka, pow37[i]));
+                if (e & 2) kb = extrared611(mulred(kb, pow37[i+1]));
+            }
+            uint64_t k = extrared611(mulred(ka, kb));
+
+            p.k = extrared611(k);
+            p.k2 = extrared611(mulred(p.k, p.k));
+            uint64_t k3 = mulred(p.k,  p.k2);
+            uint64_t k4 = mulred(p.k2, p.k2);
+            p.k7 = extrared611(mulred(k3, k4));
+            if (p.k7 < (1ULL << 60) - (1ULL << 56)) break;
+        }
+        return p;
+    }
+}
+
+
+// ---------- Parameters ----------
+// PolymurHashParams together with the powers of k that polymur_hash would
+// otherwise recompute on every call.
+struct Params {
+    PolymurHashParams c;
+    uint64_t k3, k4;               // As used for inputs of 8 to 49 bytes.
+    uint64_t k3x, k4x, k5x, k6x;   // Extra-reduced, for inputs of 50 bytes or more.
+
+    // Same as polymur_init_params and polymur_init_params_from_seed.
+    constexpr Params(uint64_t k_seed, uint64_t s_seed)
+        : c(detail::init_params(k_seed, s_seed)),
+          k3(detail::mulred(c.k, c.k2)), k4(detail::mulred(c.k2, c.k2)),
+          k3x(detail::extrared611(k3)), k4x(detail::extrared611(k4)),
+          k5x(detail::extrared611(detail::mulred(c.k, k4))), k6x(detail::extrared611(detail::mulred(c.k2, k4))) { }
+    constexpr explicit Params(uint64_t seed)
+        : Params(detail::mix(seed + POLYMUR_ARBITRARY3), detail::mix(seed + POLYMUR_ARBITRARY4)) { }
+};
+
+
+// ---------- Hashing ----------
+namespace detail {
+    // Same as polymur_hash_poly611, evaluable at compile time.
+    constexpr uint64_t poly611(const char* buf, size_t len, const Params& p, uint64_t tweak) {
+        const PolymurHashParams& c = p.c;
+        uint64_t poly_acc = tweak;
+        if (len <= 7) return poly_acc + mulred(c.k + load_le(buf, len), c.k2 + len);
+
+        uint64_t k3 = p.k3, k4 = p.k4;
+        if (len >= 50) {
+            uint64_t h = 0;
+            do {
+                uint64_t m[7] = {};
+                for (int i = 0; i < 7; ++i) m[i] = load_le(buf + 7 * i, 7);
+                U128 t0 = mul128(c.k  + m[0], p.k6x + m[1]);
+                U128 t1 = mul128(c.k2 + m[2], p.k5x + m[3]);
+                U128 t2 = mul128(p.k3x + m[4], p.k4x + m[5]);
+                U128 t3 = mul128(h + m[6], c.k7);
+                h = red611(add128(add128(t0, t1), add128(t2, t3)));
+                len -= 49;
+                buf += 49;
+            } while (len >= 50);
+            uint64_t k14 = mulred(c.k7, c.k7);
+            poly_acc += extrared611(mulred(extrared611(h), k14));
+            k3 = p.k3x;
+            k4 = p.k4x;
+        }
+
+        if (len <= 7) return poly_acc + mulred(c.k + load_le(buf, len), c.k2 + len);
+        uint64_t m0 = load_le(buf, 7);
+        uint64_t m1 = load_le(buf + (len - 7) / 2, 7);
+        uint64_t m2 = load_le(buf + len - 7, 7);
+        U128 t0 = mul128(c.k2 + m0, c.k7 + m1);
+        U128 t1 = mul128(c.k  + m2,   k3 + len);
+        if (len <= 21) return poly_acc + red611(add128(t0, t1));
+        uint64_t m3 = load_le(buf +  7, 7);
+        uint64_t m4 = load_le(buf + 14, 7);
+        uint64_t m5 = load_le(buf + len - 21, 7);
+        uint64_t m6 = load_le(buf + len - 14, 7);
+        U128 t2 = mul128(c.k2 + m3, c.k7 + m4);
+        U128 t3 = mul128(red611(t0) + m5, k4 + m6);
+        return poly_acc + red611(add128(add128(t1, t2), t3));
+    }
+}
+
+// Hashes the N bytes at data. The length class is resolved at compile time,
+// leaving only the loads and multiplications of that class.
+template<size_t N>
+inline uint64_t hash(const void* data, const Params& p, uint64_t tweak = 0) {
+    const uint8_t* buf = static_cast<const uint8_t*>(data);
+    uint64_t poly_acc = tweak;
+    if constexpr (N <= 7) {
+        uint64_t m0 = polymur_load_le_u64_0_8(buf, N);
+        poly_acc += polymur_red611(polymur_mul128(p.c.k + m0, p.c.k2 + N));
+    } else if constexpr (N <= 49) {
+        poly_acc = polymur_poly611_tail(buf, N, &p.c, p.k3, p.k4, poly_acc);
+    } else {
+        constexpr size_t nblocks = (N - 1) / 49;
+        uint64_t h = 0;
+        for (size_t b = 0; b < nblocks; ++b) {
+            h = polymur_poly611_block(buf + 49 * b, h, &p.c, p.k3x, p.k4x, p.k5x, p.k6x);
+        }
+        poly_acc += polymur_poly611_blocks_done(h, &p.c);
+        poly_acc = polymur_poly611_tail(buf + 49 * nblocks, N - 49 * nblocks, &p.c, p.k3x, p.k4x, poly_acc);
+    }
+    return polymur_mix(poly_acc) + p.c.s;
+}
+
+// Hashes the object representation of value, which may not contain padding.
+template<class T>
+inline uint64_t hash_value(const T& value, const Params& p, uint64_t tweak = 0) {
+    static_assert(std::has_unique_object_representations_v<T>, "padding bytes would make the hash unpredictable");
+    return hash<sizeof(T)>(&value, p, tweak);
+}
+
+// Hashes a string. In constant expressions this is evaluated by a constexpr
+// reimplementation, otherwise it calls polymur_hash.
+constexpr uint64_t hash(std::string_view s, const Params& p, uint64_t tweak = 0) {
+#ifdef POLYMUR_IS_CONSTANT_EVALUATED
+    if (!POLYMUR_IS_CONSTANT_EVALUATED()) {
+        return polymur_hash(reinterpret_cast<const uint8_t*>(s.data()), s.size(), &p.c, tweak);
+    }
+#endif
+    return detail::mix(detail::poly611(s.data(), s.size(), p, tweak)) + p.c.s;
+}
+
+
+
+// ---------- Hasher ----------
+// Process-wide parameters, randomly seeded on first use.
+inline const Params& default_params() {
+    static const Params params = [] {
+        std::random_device rd;
+        uint64_t k_seed = (uint64_t(rd()) << 32) | rd();
+        uint64_t s_seed = (uint64_t(rd()) << 32) | rd();
+        return Params(k_seed, s_seed);
+    }();
+    return params;
+}
+
+// Hash functor for hash tables. Strings, and anything convertible to
+// std::string_view, hash by their contents, so lookups with a std::string_view
+// or const char* don't need to construct the key type. Other keys must be
+// free of padding and are hashed by their object representation.
+//
+// Every default-constructed Hasher gets its own tweak, so that each table has
+// a different hash function, as recommended in the readme.
+struct Hasher {
+    using is_transparent = void;
+    using is_avalanching = void;
+
+    const Params* params;
+    uint64_t tweak;
+
+    Hasher() : params(&default_params()), tweak(next_tweak()) { }
+    Hasher(const Params& p, uint64_t tweak) : params(&p), tweak(tweak) { }
+
+    size_t operator()(std::string_view s) const {
+        return size_t(polymur_hash(reinterpret_cast<const uint8_t*>(s.data()), s.size(), &params->c, tweak));
+    }
+
+    template<class T, std::enable_if_t<!std::is_convertible_v<const T&, std::string_view>, int> = 0>
+    size_t operator()(const T& value) const {
+        return size_t(hash_value(value, *params, tweak));
+    }
+
+private:
+    static uint64_t next_tweak() {
+        static std::atomic<uint64_t> counter{0};
+        return polymur_mix(counter.fetch_add(1, std::memory_order_relaxed) + POLYMUR_ARBITRARY2);
+    }
+};
+
+}
+
+#endif
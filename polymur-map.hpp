@@ -0,0 +1,382 @@
+/*
+    PolymurHash flat hash map, see polymur-hash.h for the license.
+
+    A reference open-addressing hash map using polymur::Hasher. Slots are
+    grouped by 16, and next to the slots a control array holds one byte per
+    slot: either empty, deleted, or the low 7 bits of the hash of the key in
+    it. A lookup compares all 16 control bytes of a group with the key's tag
+    at once (with SSE2 if available), and only compares keys on a tag match.
+
+    Keys and values are stored inline, so inserting does not allocate except
+    when the table grows, and pointers to elements are invalidated by growth.
+*/
+
+#ifndef POLYMUR_MAP_HPP
+#define POLYMUR_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define POLYMUR_MAP_SSE2 1
+#endif
+
+#include "polymur-hash.hpp"
+
+namespace polymur {
+
+namespace detail {
+    constexpr int8_t CTRL_EMPTY = -128;
+    constexpr int8_t CTRL_DELETED = -2;
+    constexpr size_t GROUP_SIZE = 16;
+
+    // Bitmasks over the 16 control bytes of a group, bit i for byte i.
+    struct Group {
+#ifdef POLYMUR_MAP_SSE2
+        __m128i ctrl;
+
+        explicit Group(const int8_t* p) : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) { }
+
+        uint32_t match(int8_t tag) const {
+            return uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(tag))));
+        }
+
+        uint32_t match_empty() const {
+            return match(CTRL_EMPTY);
+        }
+
+        uint32_t match_empty_or_deleted() const {
+            // Both have the top bit set, full slots don't.
+            return uint32_t(_mm_movemask_epi8(ctrl));
+        }
+#else
+        const int8_t* ctrl;
+
+        explicit Group(const int8_t* p) : ctrl(p) { }
+
+        uint32_t match(int8_t tag) const {
+            uint32_t mask = 0;
+            for (size_t i = 0; i < GROUP_SIZE; ++i) mask |= uint32_t(ctrl[i] == tag) << i;
+            return mask;
+        }
+
+        uint32_t match_empty() const {
+            return match(CTRL_EMPTY);
+        }
+
+        uint32_t match_empty_or_deleted() const {
+            uint32_t mask = 0;
+            for (size_t i = 0; i < GROUP_SIZE; ++i) mask |= uint32_t(ctrl[i] < 0) << i;
+            return mask;
+        }
+#endif
+    };
+
+    inline unsigned lowest_bit(uint32_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+        return unsigned(__builtin_ctz(mask));
+#else
+        unsigned i = 0;
+        while (!(mask & 1)) { mask >>= 1; ++i; }
+        return i;
+#endif
+    }
+}
+
+template<class K, class V, class Hash = Hasher, class Eq = std::equal_to<>>
+class FlatMap {
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<K, V>;
+    using size_type = size_t;
+
+    template<bool Const>
+    class Iterator {
+    public:
+        using value_type = FlatMap::value_type;
+        using reference = std::conditional_t<Const, const value_type&, value_type&>;
+        using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+
+        Iterator() = default;
+        Iterator(const Iterator<false>& other) : map_(other.map_), i_(other.i_) { }
+
+        reference operator*() const { return map_->slots_[i_]; }
+        pointer operator->() const { return &map_->slots_[i_]; }
+        Iterator& operator++() { i_ = map_->next_full(i_ + 1); return *this; }
+        bool operator==(const Iterator& other) const { return i_ == other.i_; }
+        bool operator!=(const Iterator& other) const { return i_ != other.i_; }
+
+    private:
+        friend class FlatMap;
+        template<bool> friend class Iterator;
+        using MapPtr = std::conditional_t<Const, const FlatMap*, FlatMap*>;
+        Iterator(MapPtr map, size_t i) : map_(map), i_(i) { }
+        MapPtr map_ = nullptr;
+        size_t i_ = 0;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    // Every map gets a default-constructed Hasher, and thus its own tweak.
+    explicit FlatMap(const Hash& hash = Hash(), const Eq& eq = Eq()) : hash_(hash), eq_(eq) { }
+
+    FlatMap(const FlatMap& other) : hash_(other.hash_), eq_(other.eq_) {
+        reserve(other.size_);
+        for (const value_type& kv : other) emplace_new(hash_(kv.first), kv);
+    }
+
+    FlatMap(FlatMap&& other) noexcept
+        : hash_(other.hash_), eq_(other.eq_), ctrl_(other.ctrl_), slots_(other.slots_),
+          capacity_(other.capacity_), size_(other.size_), growth_left_(other.growth_left_) {
+        other.ctrl_ = nullptr;
+        other.slots_ = nullptr;
+        other.capacity_ = other.size_ = other.growth_left_ = 0;
+    }
+
+    FlatMap& operator=(FlatMap other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    ~FlatMap() {
+        destroy();
+    }
+
+    void swap(FlatMap& other) noexcept {
+        std::swap(hash_, other.hash_);
+        std::swap(eq_, other.eq_);
+        std::swap(ctrl_, other.ctrl_);
+        std::swap(slots_, other.slots_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(size_, other.size_);
+        std::swap(growth_left_, other.growth_left_);
+    }
+
+    iterator begin() { return iterator(this, next_full(0)); }
+    iterator end() { return iterator(this, capacity_); }
+    const_iterator begin() const { return const_iterator(this, next_full(0)); }
+    const_iterator end() const { return const_iterator(this, capacity_); }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    size_t capacity() const { return capacity_; }
+
+    // Makes room for n elements without growing.
+    void reserve(size_t n) {
+        size_t cap = detail::GROUP_SIZE;
+        while (cap - cap / 8 < n) cap *= 2;
+        if (cap > capacity_) rehash(cap);
+    }
+
+    void clear() {
+        for (size_t i = 0; i < capacity_; ++i) {
+            if (ctrl_[i] >= 0) slots_[i].~value_type();
+        }
+        if (capacity_) std::memset(ctrl_, detail::CTRL_EMPTY, capacity_);
+        size_ = 0;
+        growth_left_ = max_load(capacity_);
+    }
+
+    // Looks up key, which may be of any type Hash and Eq accept.
+    template<class Q>
+    iterator find(const Q& key) {
+        return iterator(this, find_index(key, hash_(key)));
+    }
+
+    template<class Q>
+    const_iterator find(const Q& key) const {
+        return const_iterator(this, find_index(key, hash_(key)));
+    }
+
+    template<class Q>
+    bool contains(const Q& key) const {
+        return find_index(key, hash_(key)) != capacity_;
+    }
+
+    // Inserts (key, V(args...)) if key isn't present yet.
+    template<class... Args>
+    std::pair<iterator, bool> try_emplace(const K& key, Args&&... args) {
+        size_t h = hash_(key);
+        size_t i = find_index(key, h);
+        if (i != capacity_) return {iterator(this, i), false};
+        i = emplace_new(h, std::piecewise_construct, std::forward_as_tuple(key),
+                        std::forward_as_tuple(std::forward<Args>(args)...));
+        return {iterator(this, i), true};
+    }
+
+    template<class... Args>
+    std::pair<iterator, bool> try_emplace(K&& key, Args&&... args) {
+        size_t h = hash_(key);
+        size_t i = find_index(key, h);
+        if (i != capacity_) return {iterator(this, i), false};
+        i = emplace_new(h, std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+                        std::forward_as_tuple(std::forward<Args>(args)...));
+        return {iterator(this, i), true};
+    }
+
+    std::pair<iterator, bool> insert(const value_type& kv) {
+        return try_emplace(kv.first, kv.second);
+    }
+
+    std::pair<iterator, bool> insert(value_type&& kv) {
+        return try_emplace(std::move(kv.first), std::move(kv.second));
+    }
+
+    V& operator[](const K& key) {
+        return try_emplace(key).first->second;
+    }
+
+    V& operator[](K&& key) {
+        return try_emplace(std::move(key)).first->second;
+    }
+
+    // Removes key if present, returning the number of elements removed.
+    template<class Q>
+    size_t erase(const Q& key) {
+        size_t i = find_index(key, hash_(key));
+        if (i == capacity_) return 0;
+        erase_index(i);
+        return 1;
+    }
+
+    void erase(const_iterator it) {
+        erase_index(it.i_);
+    }
+
+private:
+    static size_t max_load(size_t cap) {
+        return cap - cap / 8;
+    }
+
+    static int8_t tag(size_t h) {
+        return int8_t(h & 0x7f);
+    }
+
+    // Group index to start probing at. Uses the high bits as the low 7 bits
+    // are the tag, and the Hasher is avalanching so all bits are good.
+    size_t start_group(size_t h) const {
+        return (h >> 7) & (capacity_ / detail::GROUP_SIZE - 1);
+    }
+
+    size_t next_full(size_t i) const {
+        while (i < capacity_ && ctrl_[i] < 0) ++i;
+        return i;
+    }
+
+    // Returns the index of key, or capacity_ if absent. Probes groups
+    // triangularly, which visits every group as the group count is a power of
+    // two, and stops at the first group with an empty slot.
+    template<class Q>
+    size_t find_index(const Q& key, size_t h) const {
+        if (!capacity_) return 0;
+        size_t mask = capacity_ / detail::GROUP_SIZE - 1;
+        size_t g = start_group(h);
+        for (size_t step = 1; ; ++step) {
+            detail::Group group(ctrl_ + g * detail::GROUP_SIZE);
+            for (uint32_t m = group.match(tag(h)); m; m &= m - 1) {
+                size_t i = g * detail::GROUP_SIZE + detail::lowest_bit(m);
+                if (eq_(slots_[i].first, key)) return i;
+            }
+            if (group.match_empty()) return capacity_;
+            g = (g + step) & mask;
+        }
+    }
+
+    // First empty or deleted slot on the probe sequence of h.
+    size_t find_free(size_t h) const {
+        size_t mask = capacity_ / detail::GROUP_SIZE - 1;
+        size_t g = start_group(h);
+        for (size_t step = 1; ; ++step) {
+            uint32_t m = detail::Group(ctrl_ + g * detail::GROUP_SIZE).match_empty_or_deleted();
+            if (m) return g * detail::GROUP_SIZE + detail::lowest_bit(m);
+            g = (g + step) & mask;
+        }
+    }
+
+    // Constructs an element for a key known to be absent, with hash h.
+    template<class... Args>
+    size_t emplace_new(size_t h, Args&&... args) {
+        if (!capacity_) rehash(detail::GROUP_SIZE);
+        size_t i = find_free(h);
+        if (ctrl_[i] == detail::CTRL_EMPTY && growth_left_ == 0) {
+            // Only grow if there are few deleted slots, otherwise rehashing
+            // in place cleans them up.
+            rehash(size_ * 2 >= max_load(capacity_) ? capacity_ * 2 : capacity_);
+            i = find_free(h);
+        }
+        new (&slots_[i]) value_type(std::forward<Args>(args)...);
+        if (ctrl_[i] == detail::CTRL_EMPTY) --growth_left_;
+        ctrl_[i] = tag(h);
+        ++size_;
+        return i;
+    }
+
+    void erase_index(size_t i) {
+        slots_[i].~value_type();
+        --size_;
+        // If this group has an empty slot no probe sequence continued past
+        // it, so this slot can become empty rather than a tombstone.
+        size_t g = i / detail::GROUP_SIZE;
+        if (detail::Group(ctrl_ + g * detail::GROUP_SIZE).match_empty()) {
+            ctrl_[i] = detail::CTRL_EMPTY;
+            ++growth_left_;
+        } else {
+            ctrl_[i] = detail::CTRL_DELETED;
+        }
+    }
+
+    void rehash(size_t new_capacity) {
+        int8_t* old_ctrl = ctrl_;
+        value_type* old_slots = slots_;
+        size_t old_capacity = capacity_;
+
+        ctrl_ = static_cast<int8_t*>(::operator new(new_capacity));
+        slots_ = std::allocator<value_type>().allocate(new_capacity);
+        std::memset(ctrl_, detail::CTRL_EMPTY, new_capacity);
+        capacity_ = new_capacity;
+        growth_left_ = max_load(new_capacity) - size_;
+
+        for (size_t i = 0; i < old_capacity; ++i) {
+            if (old_ctrl[i] < 0) continue;
+            size_t h = hash_(old_slots[i].first);
+            size_t j = find_free(h);
+            new (&slots_[j]) value_type(std::move(old_slots[i]));
+            ctrl_[j] = tag(h);
+            old_slots[i].~value_type();
+        }
+
+        if (old_capacity) {
+            ::operator delete(old_ctrl);
+            std::allocator<value_type>().deallocate(old_slots, old_capacity);
+        }
+    }
+
+    void destroy() {
+        if (!capacity_) return;
+        for (size_t i = 0; i < capacity_; ++i) {
+            if (ctrl_[i] >= 0) slots_[i].~value_type();
+        }
+        ::operator delete(ctrl_);
+        std::allocator<value_type>().deallocate(slots_, capacity_);
+    }
+
+    Hash hash_;
+    Eq eq_;
+    int8_t* ctrl_ = nullptr;
+    value_type* slots_ = nullptr;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+    size_t growth_left_ = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,232 @@
+/*
+    PolymurHash sketches, see polymur-hash.h for the license.
+
+    A blocked Bloom filter and a blocked count-min sketch. Each key is read
+    once by polymur_hash_poly611, after which all probe positions come from
+    two runs of polymur_mix with different tweaks. All probes of a key fall in
+    a single 64-byte block, so every operation touches one cache line.
+*/
+
+#ifndef POLYMUR_SKETCH_H
+#define POLYMUR_SKETCH_H
+
+#include "polymur-hash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ---------- PolymurHash sketch API ----------
+// Bloom filter over nblocks blocks of 512 bits, setting k bits per key. The
+// caller provides nblocks * 8 zeroed words, preferably 64-byte aligned, and
+// nblocks may be at most 2^32. About 10 bits per key with k = 7 gives a false
+// positive rate near 1%, slightly above that of an unblocked filter.
+typedef struct {
+    uint64_t* words;
+    size_t nblocks;
+    unsigned k;
+    uint64_t tweak;
+    const PolymurHashParams* p;
+} PolymurBloom;
+
+static inline void polymur_bloom_init(PolymurBloom* b, uint64_t* words, size_t nblocks, unsigned k,
+                                      const PolymurHashParams* p, uint64_t tweak);
+static inline void polymur_bloom_insert(PolymurBloom* b, const uint8_t* key, size_t len);
+static inline int polymur_bloom_query(const PolymurBloom* b, const uint8_t* key, size_t len);
+
+// Same as calling polymur_bloom_insert or polymur_bloom_query for each key,
+// with out[i] set to the query result for keys[i]. The keys are hashed as in
+// polymur_hash_batch and all their blocks are prefetched before use.
+static inline void polymur_bloom_insert_batch(PolymurBloom* b, const uint8_t* const* keys, const size_t* lens, size_t n);
+static inline void polymur_bloom_query_batch(const PolymurBloom* b, const uint8_t* const* keys, const size_t* lens,
+                                             size_t n, uint8_t* out);
+
+// Count-min sketch over nblocks blocks of 16 saturating 32-bit counters,
+// using depth distinct counters of one block per key, clamped to 16. The caller
+// provides nblocks * 16 zeroed counters, preferably 64-byte aligned, and
+// nblocks may be at most 2^32. Estimates are never below the true count.
+typedef struct {
+    uint32_t* counters;
+    size_t nblocks;
+    unsigned depth;
+    uint64_t tweak;
+    const PolymurHashParams* p;
+} PolymurCountMin;
+
+static inline void polymur_cm_init(PolymurCountMin* cm, uint32_t* counters, size_t nblocks, unsigned depth,
+                                   const PolymurHashParams* p, uint64_t tweak);
+static inline void polymur_cm_add(PolymurCountMin* cm, const uint8_t* key, size_t len, uint32_t count);
+static inline uint32_t polymur_cm_estimate(const PolymurCountMin* cm, const uint8_t* key, size_t len);
+
+// Batched versions, adding counts[i] (or 1 if counts is NULL) for keys[i] and
+// setting out[i] to the estimate for keys[i].
+static inline void polymur_cm_add_batch(PolymurCountMin* cm, const uint8_t* const* keys, const size_t* lens,
+                                        const uint32_t* counts, size_t n);
+static inline void polymur_cm_estimate_batch(const PolymurCountMin* cm, const uint8_t* const* keys, const size_t* lens,
+                                             size_t n, uint32_t* out);
+
+
+// ---------- Implementation ----------
+// Given poly, the polymur_hash_poly611 of a key with the sketch tweak, the
+// block is chosen by polymur_hash(key, tweak) itself and the positions within
+// it by a second mix, using Kirsch-Mitzenmacher double hashing a + i * b.
+static inline size_t polymur_sketch_block(uint64_t poly, const PolymurHashParams* p, size_t nblocks) {
+    uint64_t h = polymur_mix(poly) + p->s;
+    return (size_t) (((h >> 32) * (uint64_t) nblocks) >> 32);
+}
+
+static inline uint64_t polymur_sketch_probes(uint64_t poly) {
+    return polymur_mix(poly + POLYMUR_ARBITRARY4);
+}
+
+// Sets bit (a + i * b) >> 23 of the block for i < k, or checks them if set is 0.
+static inline int polymur_bloom_block(uint64_t* block, uint64_t probes, unsigned k, int set) {
+    uint32_t a = (uint32_t) probes;
+    uint32_t b = (uint32_t) (probes >> 32);
+    uint64_t found = 1;
+    for (unsigned i = 0; i < k; ++i) {
+        uint32_t bit = a >> 23;
+        if (set) block[bit >> 6] |= 1ULL << (bit & 63);
+        else found &= block[bit >> 6] >> (bit & 63);
+        a += b;
+    }
+    return (int) found;
+}
+
+static inline void polymur_bloom_init(PolymurBloom* b, uint64_t* words, size_t nblocks, unsigned k,
+                                      const PolymurHashParams* p, uint64_t tweak) {
+    b->words = words;
+    b->nblocks = nblocks;
+    b->k = k;
+    b->tweak = tweak;
+    b->p = p;
+}
+
+static inline void polymur_bloom_insert(PolymurBloom* b, const uint8_t* key, size_t len) {
+    uint64_t poly = polymur_hash_poly611(key, len, b->p, b->tweak);
+    uint64_t* block = b->words + 8 * polymur_sketch_block(poly, b->p, b->nblocks);
+    polymur_bloom_block(block, polymur_sketch_probes(poly), b->k, 1);
+}
+
+static inline int polymur_bloom_query(const PolymurBloom* b, const uint8_t* key, size_t len) {
+    uint64_t poly = polymur_hash_poly611(key, len, b->p, b->tweak);
+    uint64_t* block = b->words + 8 * polymur_sketch_block(poly, b->p, b->nblocks);
+    return polymur_bloom_block(block, polymur_sketch_probes(poly), b->k, 0);
+}
+
+// Hashes a chunk of keys, replacing acc[j] by the block index of key j and
+// probes[j] by its probe positions, and prefetches the blocks.
+static inline void polymur_sketch_chunk(const uint8_t* const* keys, const size_t* lens, size_t w,
+                                        const PolymurHashParams* p, const PolymurBatchPowers* kp, uint64_t tweak,
+                                        const void* blocks, size_t nblocks, uint64_t* acc, uint64_t* probes) {
+    for (size_t j = 0; j < w; ++j) acc[j] = tweak;
+    polymur_poly611_chunk(keys, lens, w, p, kp, acc);
+    for (size_t j = 0; j < w; ++j) {
+        probes[j] = polymur_sketch_probes(acc[j]);
+        acc[j] = polymur_sketch_block(acc[j], p, nblocks);
+        POLYMUR_PREFETCH((const char*) blocks + 64 * acc[j]);
+    }
+}
+
+static inline void polymur_bloom_insert_batch(PolymurBloom* b, const uint8_t* const* keys, const size_t* lens, size_t n) {
+    PolymurBatchPowers kp;
+    polymur_batch_powers(b->p, &kp);
+    uint64_t block[POLYMUR_BATCH_CHUNK], probes[POLYMUR_BATCH_CHUNK];
+    for (size_t base = 0; base < n; base += POLYMUR_BATCH_CHUNK) {
+        size_t w = n - base < POLYMUR_BATCH_CHUNK ? n - base : POLYMUR_BATCH_CHUNK;
+        polymur_sketch_chunk(keys + base, lens + base, w, b->p, &kp, b->tweak, b->words, b->nblocks, block, probes);
+        for (size_t j = 0; j < w; ++j) polymur_bloom_block(b->words + 8 * block[j], probes[j], b->k, 1);
+    }
+}
+
+static inline void polymur_bloom_query_batch(const PolymurBloom* b, const uint8_t* const* keys, const size_t* lens,
+                                             size_t n, uint8_t* out) {
+    PolymurBatchPowers kp;
+    polymur_batch_powers(b->p, &kp);
+    uint64_t block[POLYMUR_BATCH_CHUNK], probes[POLYMUR_BATCH_CHUNK];
+    for (size_t base = 0; base < n; base += POLYMUR_BATCH_CHUNK) {
+        size_t w = n - base < POLYMUR_BATCH_CHUNK ? n - base : POLYMUR_BATCH_CHUNK;
+        polymur_sketch_chunk(keys + base, lens + base, w, b->p, &kp, b->tweak, b->words, b->nblocks, block, probes);
+        for (size_t j = 0; j < w; ++j) {
+            out[base + j] = (uint8_t) polymur_bloom_block(b->words + 8 * block[j], probes[j], b->k, 0);
+        }
+    }
+}
+
+// Adds count to the first depth counters of a random permutation of the 16 in
+// the block, or returns their minimum if add is 0. The permutation is a
+// partial Fisher-Yates shuffle of nibbles, drawing each swap from 32 bits of
+// probes by multiplication, so any depth counters can be chosen. An odd step
+// a + i * b mod 16 would give only 128 patterns per block.
+static inline uint32_t polymur_cm_block(uint32_t* block, uint64_t probes, unsigned depth, int add, uint32_t count) {
+    uint64_t perm = 0xfedcba9876543210ULL;
+    uint32_t r = (uint32_t) probes;
+    uint32_t min = UINT32_MAX;
+    for (unsigned i = 0; i < depth; ++i) {
+        if (i == 8) r = (uint32_t) (probes >> 32);
+        uint64_t t = (uint64_t) r * (16 - i);
+        unsigned j = i + (unsigned) (t >> 32);
+        r = (uint32_t) t;
+        uint64_t swap = ((perm >> (4 * i)) ^ (perm >> (4 * j))) & 15;
+        perm ^= (swap << (4 * i)) | (swap << (4 * j));
+        uint32_t* c = &block[(perm >> (4 * i)) & 15];
+        if (add) *c = *c + count < *c ? UINT32_MAX : *c + count;
+        else min = *c < min ? *c : min;
+    }
+    return min;
+}
+
+static inline void polymur_cm_init(PolymurCountMin* cm, uint32_t* counters, size_t nblocks, unsigned depth,
+                                   const PolymurHashParams* p, uint64_t tweak) {
+    cm->counters = counters;
+    cm->nblocks = nblocks;
+    cm->depth = depth < 16 ? depth : 16;
+    cm->tweak = tweak;
+    cm->p = p;
+}
+
+static inline void polymur_cm_add(PolymurCountMin* cm, const uint8_t* key, size_t len, uint32_t count) {
+    uint64_t poly = polymur_hash_poly611(key, len, cm->p, cm->tweak);
+    uint32_t* block = cm->counters + 16 * polymur_sketch_block(poly, cm->p, cm->nblocks);
+    polymur_cm_block(block, polymur_sketch_probes(poly), cm->depth, 1, count);
+}
+
+static inline uint32_t polymur_cm_estimate(const PolymurCountMin* cm, const uint8_t* key, size_t len) {
+    uint64_t poly = polymur_hash_poly611(key, len, cm->p, cm->tweak);
+    uint32_t* block = cm->counters + 16 * polymur_sketch_block(poly, cm->p, cm->nblocks);
+    return polymur_cm_block(block, polymur_sketch_probes(poly), cm->depth, 0, 0);
+}
+
+static inline void polymur_cm_add_batch(PolymurCountMin* cm, const uint8_t* const* keys, const size_t* lens,
+                                        const uint32_t* counts, size_t n) {
+    PolymurBatchPowers kp;
+    polymur_batch_powers(cm->p, &kp);
+    uint64_t block[POLYMUR_BATCH_CHUNK], probes[POLYMUR_BATCH_CHUNK];
+    for (size_t base = 0; base < n; base += POLYMUR_BATCH_CHUNK) {
+        size_t w = n - base < POLYMUR_BATCH_CHUNK ? n - base : POLYMUR_BATCH_CHUNK;
+        polymur_sketch_chunk(keys + base, lens + base, w, cm->p, &kp, cm->tweak, cm->counters, cm->nblocks, block, probes);
+        for (size_t j = 0; j < w; ++j) {
+            polymur_cm_block(cm->counters + 16 * block[j], probes[j], cm->depth, 1, counts ? counts[base + j] : 1);
+        }
+    }
+}
+
+static inline void polymur_cm_estimate_batch(const PolymurCountMin* cm, const uint8_t* const* keys, const size_t* lens,
+                                             size_t n, uint32_t* out) {
+    PolymurBatchPowers kp;
+    polymur_batch_powers(cm->p, &kp);
+    uint64_t block[POLYMUR_BATCH_CHUNK], probes[POLYMUR_BATCH_CHUNK];
+    for (size_t base = 0; base < n; base += POLYMUR_BATCH_CHUNK) {
+        size_t w = n - base < POLYMUR_BATCH_CHUNK ? n - base : POLYMUR_BATCH_CHUNK;
+        polymur_sketch_chunk(keys + base, lens + base, w, cm->p, &kp, cm->tweak, cm->counters, cm->nblocks, block, probes);
+        for (size_t j = 0; j < w; ++j) {
+            out[base + j] = polymur_cm_block(cm->counters + 16 * block[j], probes[j], cm->depth, 0, 0);
+        }
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,275 @@
+// polymur-sum: prints or checks PolymurHash checksums of files. Build with
+//
+//     cc -O2 -pthread polymur-sum.c -o polymur-sum
+//
+// Usage: polymur-sum [-s seed] [-t tweak] [-j threads] [-c] [file...]
+//
+// Prints one line per file with the 16 hex digit hash and the path, where the
+// hash equals polymur_hash of the file contents with the parameters from
+// polymur_init_params_from_seed(seed) and the given tweak (both default to 0).
+// With -c (or --check) the files are instead manifests of such lines, and
+// each listed file is re-hashed and reported as OK or FAILED. A path of - or
+// no paths at all reads standard input, which may be named only once.
+
+#define _FILE_OFFSET_BITS 64
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "polymur-hash.h"
+
+#define SUM_READ_SIZE (1 << 20)
+#define SUM_MAX_THREADS 256
+
+static PolymurHashParams sum_params;
+static uint64_t sum_tweak;
+
+// Hashes everything readable from fd with large reads.
+static int sum_stream(int fd, uint64_t* out) {
+    static __thread uint8_t* buf;
+    if (!buf && !(buf = (uint8_t*) malloc(SUM_READ_SIZE))) return ENOMEM;
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    PolymurHashState st;
+    polymur_hash_init(&st, &sum_params, sum_tweak);
+    while (1) {
+        ssize_t n = read(fd, buf, SUM_READ_SIZE);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return errno;
+        if (n == 0) break;
+        polymur_hash_update(&st, buf, (size_t) n);
+    }
+    *out = polymur_hash_finalize(&st);
+    return 0;
+}
+
+// Hashes the file at path, returning 0 or an errno value. Regular files are
+// memory-mapped, anything else or files that can't be mapped are streamed.
+static int sum_file(const char* path, uint64_t* out) {
+    if (strcmp(path, "-") == 0) return sum_stream(STDIN_FILENO, out);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return errno;
+    struct stat sb;
+    int err = fstat(fd, &sb) ? errno : 0;
+    if (!err && S_ISDIR(sb.st_mode)) err = EISDIR;
+    if (err) {
+        close(fd);
+        return err;
+    }
+
+    void* map = MAP_FAILED;
+    if (S_ISREG(sb.st_mode) && sb.st_size > 0 && (uint64_t) sb.st_size <= SIZE_MAX) {
+        map = mmap(NULL, (size_t) sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    if (map != MAP_FAILED) {
+        madvise(map, (size_t) sb.st_size, MADV_SEQUENTIAL);
+        *out = polymur_hash((const uint8_t*) map, (size_t) sb.st_size, &sum_params, sum_tweak);
+        munmap(map, (size_t) sb.st_size);
+    } else {
+        err = sum_stream(fd, out);
+    }
+    close(fd);
+    return err;
+}
+
+
+// ---------- Worker pool ----------
+// Workers claim files in order and hash them, the main thread prints results
+// in the same order as soon as they are done.
+typedef struct {
+    const char* path;
+    uint64_t expected; // In check mode.
+    uint64_t hash;
+    int err;
+    int done;
+} SumJob;
+
+static SumJob* sum_jobs;
+static size_t sum_njobs, sum_next;
+static pthread_mutex_t sum_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sum_cond = PTHREAD_COND_INITIALIZER;
+
+static void* sum_worker(void* arg) {
+    (void) arg;
+    while (1) {
+        pthread_mutex_lock(&sum_lock);
+        size_t i = sum_next++;
+        pthread_mutex_unlock(&sum_lock);
+        if (i >= sum_njobs) return NULL;
+
+        uint64_t h = 0;
+        int err = sum_file(sum_jobs[i].path, &h);
+        pthread_mutex_lock(&sum_lock);
+        sum_jobs[i].hash = h;
+        sum_jobs[i].err = err;
+        sum_jobs[i].done = 1;
+        pthread_cond_broadcast(&sum_cond);
+        pthread_mutex_unlock(&sum_lock);
+    }
+}
+
+// Hashes all jobs, returning the number of failures.
+static size_t sum_run(size_t nthreads, int check) {
+    pthread_t threads[SUM_MAX_THREADS];
+    size_t nstarted = 0;
+    while (nstarted < nthreads && nstarted < sum_njobs) {
+        if (pthread_create(&threads[nstarted], NULL, sum_worker, NULL)) break;
+        ++nstarted;
+    }
+    if (!nstarted) sum_worker(NULL);
+
+    size_t failures = 0;
+    for (size_t i = 0; i < sum_njobs; ++i) {
+        pthread_mutex_lock(&sum_lock);
+        while (!sum_jobs[i].done) pthread_cond_wait(&sum_cond, &sum_lock);
+        pthread_mutex_unlock(&sum_lock);
+
+        SumJob* job = &sum_jobs[i];
+        if (job->err) {
+            fprintf(stderr, "polymur-sum: %s: %s\n", job->path, strerror(job->err));
+            ++failures;
+        } else if (check) {
+            int ok = job->hash == job->expected;
+            printf("%s: %s\n", job->path, ok ? "OK" : "FAILED");
+            failures += !ok;
+        } else {
+            printf("%016" PRIx64 "  %s\n", job->hash, job->path);
+        }
+    }
+
+    for (size_t t = 0; t < nstarted; ++t) pthread_join(threads[t], NULL);
+    return failures;
+}
+
+
+// ---------- Command line ----------
+// Standard input can only be read once, either as a manifest or as a file.
+static int sum_stdin_used;
+
+static int sum_claim_stdin(void) {
+    if (sum_stdin_used) return 0;
+    sum_stdin_used = 1;
+    return 1;
+}
+
+static void sum_add_job(const char* path, uint64_t expected) {
+    static size_t capacity;
+    if (sum_njobs == capacity) {
+        capacity = capacity ? 2 * capacity : 64;
+        sum_jobs = (SumJob*) realloc(sum_jobs, capacity * sizeof(*sum_jobs));
+        if (!sum_jobs) {
+            fprintf(stderr, "polymur-sum: out of memory\n");
+            exit(2);
+        }
+    }
+    SumJob job = {path, expected, 0, 0, 0};
+    sum_jobs[sum_njobs++] = job;
+}
+
+// Adds the files listed in a manifest, returning the number of bad lines.
+static size_t sum_read_manifest(const char* path) {
+    if (strcmp(path, "-") == 0 && !sum_claim_stdin()) {
+        fprintf(stderr, "polymur-sum: standard input given more than once\n");
+        return 1;
+    }
+    FILE* f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "polymur-sum: %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    size_t bad = 0, lineno = 0, cap = 0;
+    char* line = NULL;
+    ssize_t len;
+    while ((len = getline(&line, &cap, f)) >= 0) {
+        ++lineno;
+        if (len > 0 && line[len - 1] == '\n') line[--len] = 0;
+
+        // strtoull alone would also accept leading whitespace, signs and 0x.
+        int ok = len >= 19 && line[16] == ' ' && line[17] == ' ';
+        for (int j = 0; ok && j < 16; ++j) ok = isxdigit((unsigned char) line[j]);
+        if (!ok) {
+            fprintf(stderr, "polymur-sum: %s:%zu: improperly formatted line\n", path, lineno);
+            ++bad;
+            continue;
+        }
+        if (strcmp(line + 18, "-") == 0 && !sum_claim_stdin()) {
+            fprintf(stderr, "polymur-sum: %s:%zu: standard input given more than once\n", path, lineno);
+            ++bad;
+            continue;
+        }
+        sum_add_job(strdup(line + 18), strtoull(line, NULL, 16));
+    }
+    free(line);
+    if (f != stdin) fclose(f);
+    return bad;
+}
+
+static int sum_parse_u64(const char* s, uint64_t* out) {
+    char* end;
+    errno = 0;
+    *out = strtoull(s, &end, 0);
+    return errno == 0 && *s && !*end;
+}
+
+static void sum_usage(void) {
+    fprintf(stderr, "usage: polymur-sum [-s seed] [-t tweak] [-j threads] [-c|--check] [file...]\n");
+    exit(2);
+}
+
+int main(int argc, char** argv) {
+    uint64_t seed = 0, nthreads = (uint64_t) sysconf(_SC_NPROCESSORS_ONLN);
+    int check = 0, i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1]; ++i) {
+        const char* opt = argv[i];
+        if (strcmp(opt, "--") == 0) { ++i; break; }
+        if (strcmp(opt, "-c") == 0 || strcmp(opt, "--check") == 0) { check = 1; continue; }
+        if (i + 1 >= argc) sum_usage();
+        const char* val = argv[++i];
+        if (strcmp(opt, "-s") == 0) {
+            if (!sum_parse_u64(val, &seed)) sum_usage();
+        } else if (strcmp(opt, "-t") == 0) {
+            if (!sum_parse_u64(val, &sum_tweak)) sum_usage();
+        } else if (strcmp(opt, "-j") == 0) {
+            if (!sum_parse_u64(val, &nthreads)) sum_usage();
+        } else {
+            sum_usage();
+        }
+    }
+    if (nthreads < 1) nthreads = 1;
+    if (nthreads > SUM_MAX_THREADS) nthreads = SUM_MAX_THREADS;
+    polymur_init_params_from_seed(&sum_params, seed);
+
+    size_t failures = 0;
+    if (i == argc) {
+        if (check) failures += sum_read_manifest("-");
+        else sum_add_job("-", 0);
+    }
+    for (; i < argc; ++i) {
+        if (check) {
+            failures += sum_read_manifest(argv[i]);
+        } else if (strcmp(argv[i], "-") == 0 && !sum_claim_stdin()) {
+            fprintf(stderr, "polymur-sum: standard input given more than once\n");
+            return 2;
+        } else {
+            sum_add_job(argv[i], 0);
+        }
+    }
+
+    failures += sum_run((size_t) nthreads, check);
+    if (check && failures) fprintf(stderr, "polymur-sum: WARNING: %zu checks failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -2,7 +2,15 @@
 #include <stdint.h>
 #include <inttypes.h>
 
+// Also build without __int128 to check the portable arithmetic, which 32-bit
+// targets use, against POLYMUR_REFERENCE_VALUES:
+//     cc -O2 -m32 test.c                 (needs a 32-bit libc)
+//     cc -O2 -U__SIZEOF_INT128__ test.c  (same code path on a 64-bit target)
+#define POLYMUR_MIN_SEGMENT_BLOCKS 1 // Exercise parallel hashing on short inputs.
 #include "polymur-hash.h"
+#include "polymur-columnar.h"
+#include "polymur-cdc.h"
+#include "polymur-sketch.h"
 
 static const char* const POLYMUR_TEST_STRINGS[] = {
     "",
@@ -136,11 +144,693 @@ static const uint64_t POLYMUR_REFERENCE_VALUES[] = {
     0xc3df94778f1eec30ULL, 0x7509771e4127701eULL, 0x28240c74c56f8f7cULL, 0x194fa4f68aab8e27ULL
 };
 
+// High halves of polymur_hash128 for the test strings, the low halves equal
+// POLYMUR_REFERENCE_VALUES.
+static const uint64_t POLYMUR_REFERENCE_VALUES128_HI[] = {
+    0x7a0142866cbab01bULL, 0xb5c365ef6f7ea83cULL, 0x10d24d02b96934e1ULL, 0x9b45c3e27d02a6a3ULL,
+    0x3d6b19148ddfb1b0ULL, 0xddc4675c7df44560ULL, 0xc6e070065a70d45fULL, 0x47c837e937f458aaULL,
+    0xe63ac6cd620b1876ULL, 0x6459316593871deeULL, 0x12a6cd88be923cdaULL, 0xfcfb7f2801c66657ULL,
+    0xab89a4614a4c5cb7ULL, 0xc9e7b3fb614c80d7ULL, 0x8c91c2630aab8eb7ULL, 0x8b1b9f0c366478b1ULL,
+    0xa53c43a02b2881a6ULL, 0x5a1dc541b1e56bc8ULL, 0x342ba654b224f383ULL, 0xd7f1ed54b289c1bdULL,
+    0xd881f8250cafbc1aULL, 0x03fa7069858b40f4ULL, 0x858360c4fc1ec54aULL, 0x2e5073fb3dc94d29ULL,
+    0x81eee2851b883a47ULL, 0xac2cb327710b08c6ULL, 0xc3e1712cb078abcaULL, 0xedce41545c012d7cULL,
+    0xd45c4555779fe3ecULL, 0xc5051c5c7dd2f9cbULL, 0xda13154a74f9f06cULL, 0xe286ee3c4140121dULL,
+    0x27021d3942cd2ea4ULL, 0x151ebcbe7ce6bb0fULL, 0xd7bd6621205d3c07ULL, 0x903db4f6e432780fULL,
+    0xc31acd32237b2a78ULL, 0x1e717dc065763c27ULL, 0x0ddafe163bb9b8f5ULL, 0x5b38f3be982173e4ULL,
+    0xea53c0a22d143389ULL, 0x3fbb8f8df6086f33ULL, 0x130d4acbe1f214baULL, 0x9a9d5246a45259acULL,
+    0xaac1d0ca619fb8b0ULL, 0x0945b14e6d1a4a14ULL, 0x97868b7b7ba0da5aULL, 0x03dbf73d2eda526fULL,
+    0xe876cfa164ab0e11ULL, 0x64a719e59740bc05ULL, 0x11177d3b963f50b5ULL, 0xeb4c1517e2b14d48ULL,
+    0x9b8cb0c29249bcb0ULL, 0x4f40d5bad3ec140aULL, 0x457a98703a2bad1cULL, 0xb65e5fb3d39019c9ULL,
+    0xa2893ef0ae5817e2ULL, 0x5bfe09d88c7c7644ULL, 0x66d4d430ad70ac25ULL, 0x6c1b4af6b761f230ULL,
+    0x3aa719505126f211ULL, 0x5af704d10d2d0f54ULL, 0x42e145337c2d2acfULL, 0x518841863df70aebULL,
+    0xe30d139536a8b866ULL, 0xcf63e2ddf204313aULL, 0x9a32237bd3d3850eULL, 0x8084c484b9ba36a9ULL,
+    0xa95049fa78df6c9cULL, 0x525fd2ac06a5687cULL, 0x5e43fbb706d22febULL, 0x72c25d549c10a18aULL,
+    0x23aef98d4aa752b8ULL, 0xedbd59f1e8535e58ULL, 0x6f60e9c08317d970ULL, 0x3bbd802f045c1b21ULL,
+    0xbeb4a9b940bcf548ULL, 0xa97a38e518fcef3cULL, 0xbb4cf778595be622ULL, 0x417ae455bafc2b33ULL,
+    0xb0883d3bad12d152ULL, 0x001b5a00075cbdc8ULL, 0xebc49cb5b5cd6a72ULL, 0x354da437223cf26bULL,
+    0xaee5ec69aa57c23eULL, 0x870e95b9be565d18ULL, 0x3be8ddbd78d18ae8ULL, 0xa1f523095129e696ULL,
+    0x7d0e3aac1303d0bcULL, 0xe1dee3b117a59cbaULL, 0x46c0084d961d21b0ULL, 0xbbe248b39fc0e235ULL,
+    0xefd1c4aadf5262b1ULL, 0x82301e285a7ee14dULL, 0x35a72f4d322cd7ddULL, 0x5b3c8663a195c0d6ULL,
+    0x731bc17030db1f02ULL, 0x15a8faadb82c721aULL, 0x0967372dbe3b504bULL, 0x0dc7669d39c0492eULL
+};
+
+// Deterministic pseudo-random test input.
+static void fill_test_data(uint8_t* buf, size_t len, uint64_t seed) {
+    for (size_t i = 0; i < len; ++i) buf[i] = (uint8_t) polymur_mix(seed + i);
+}
+
+// The original single-function implementation of polymur_hash_poly611, kept
+// as a reference to test the optimized code paths against.
+static uint64_t reference_poly611(const uint8_t* buf, size_t len, const PolymurHashParams* p, uint64_t tweak) {
+    uint64_t m[7];
+    uint64_t poly_acc = tweak;
+
+    if (len <= 7) {
+        m[0] = polymur_load_le_u64_0_8(buf, len);
+        return poly_acc + polymur_red611(polymur_mul128(p->k + m[0], p->k2 + len));
+    }
+    
+    uint64_t k3 = polymur_red611(polymur_mul128( p->k, p->k2));
+    uint64_t k4 = polymur_red611(polymur_mul128(p->k2, p->k2));
+    if (len >= 50) {
+        const uint64_t k5 = polymur_extrared611(polymur_red611(polymur_mul128(p->k,  k4)));
+        const uint64_t k6 = polymur_extrared611(polymur_red611(polymur_mul128(p->k2, k4)));
+        k3 = polymur_extrared611(k3);
+        k4 = polymur_extrared611(k4);
+        uint64_t h = 0;
+        do {
+            for (int i = 0; i < 7; ++i) m[i] = polymur_load_le_u64(buf + 7*i) & 0x00ffffffffffffffULL;
+            polymur_u128_t t0 = polymur_mul128(p->k  + m[0], k6 + m[1]);
+            polymur_u128_t t1 = polymur_mul128(p->k2 + m[2], k5 + m[3]);
+            polymur_u128_t t2 = polymur_mul128(   k3 + m[4], k4 + m[5]);
+            polymur_u128_t t3 = polymur_mul128(   h  + m[6], p->k7);
+            polymur_u128_t  s = polymur_add128(polymur_add128(t0, t1), polymur_add128(t2, t3));
+            h = polymur_red611(s);
+            len -= 49;
+            buf += 49;
+        } while (len >= 50);
+        const uint64_t k14 = polymur_red611(polymur_mul128(p->k7, p->k7));
+        uint64_t hk14 = polymur_red611(polymur_mul128(polymur_extrared611(h), k14));
+        poly_acc += polymur_extrared611(hk14);
+    }
+    
+    if (len >= 8) {
+        m[0] = polymur_load_le_u64(buf) & 0x00ffffffffffffffULL;
+        m[1] = polymur_load_le_u64(buf + (len - 7) / 2) & 0x00ffffffffffffffULL;
+        m[2] = polymur_load_le_u64(buf + len - 8) >> 8;
+        polymur_u128_t t0 = polymur_mul128(p->k2 + m[0], p->k7 + m[1]);
+        polymur_u128_t t1 = polymur_mul128(p->k  + m[2],    k3 + len);
+        if (len <= 21) return poly_acc + polymur_red611(polymur_add128(t0, t1));
+        m[3] = polymur_load_le_u64(buf +  7) & 0x00ffffffffffffffULL;
+        m[4] = polymur_load_le_u64(buf + 14) & 0x00ffffffffffffffULL;
+        m[5] = polymur_load_le_u64(buf + len - 21) & 0x00ffffffffffffffULL;
+        m[6] = polymur_load_le_u64(buf + len - 14) & 0x00ffffffffffffffULL;
+        uint64_t t0r = polymur_red611(t0);
+        polymur_u128_t t2 = polymur_mul128(p->k2 + m[3], p->k7 + m[4]);
+        polymur_u128_t t3 = polymur_mul128(  t0r + m[5],    k4 + m[6]);
+        polymur_u128_t s = polymur_add128(polymur_add128(t1, t2), t3);
+        return poly_acc + polymur_red611(s);
+    }
+
+    m[0] = polymur_load_le_u64_0_8(buf, len);
+    return poly_acc + polymur_red611(polymur_mul128(p->k + m[0], p->k2 + len));
+}
+
+static int test_against_reference(const PolymurHashParams* p, uint64_t tweak) {
+    static uint8_t buf[4096 + 8];
+    fill_test_data(buf, sizeof(buf), 5);
+    for (size_t len = 0; len <= 4096; ++len) {
+        for (size_t offset = 0; offset < 8; offset += 3) {
+            uint64_t expected = polymur_mix(reference_poly611(buf + offset, len, p, tweak)) + p->s;
+            if (polymur_hash(buf + offset, len, p, tweak) != expected) {
+                printf("reference implementation test failed for length %zu at offset %zu\n", len, offset);
+                return 1;
+            }
+        }
+    }
+
+    // All-ones input maximizes the intermediate values.
+    memset(buf, 0xff, sizeof(buf));
+    for (size_t len = 0; len <= 4096; ++len) {
+        if (polymur_hash(buf, len, p, tweak) != polymur_mix(reference_poly611(buf, len, p, tweak)) + p->s) {
+            printf("reference implementation test failed for length %zu of all ones\n", len);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+#ifdef POLYMUR_HAS_AVX512IFMA
+// Differential test of the multi-lane block kernel against the serial block
+// loop, for several keys and lane lengths, including the all-ones maximum.
+static int test_avx512_blocks(void) {
+    if (!polymur_cpu_has_avx512ifma()) return 0;
+    static uint8_t buf[8 * 49 * 64 + 8];
+    for (int fill = 0; fill < 2; ++fill) {
+        if (fill) memset(buf, 0xff, sizeof(buf));
+        else fill_test_data(buf, sizeof(buf), 7);
+        for (uint64_t seed = 0; seed < 8; ++seed) {
+            PolymurHashParams p;
+            polymur_init_params_from_seed(&p, seed);
+            uint64_t k3, k4, k5, k6;
+            polymur_poly611_powers(&p, &k3, &k4, &k5, &k6);
+            for (size_t s = 0; s <= 64; ++s) {
+                uint64_t h = 0;
+                for (size_t b = 0; b < 8 * s; ++b) h = polymur_poly611_block(buf + 49 * b, h, &p, k3, k4, k5, k6);
+                if (polymur_poly611_blocks_avx512(buf, s, &p, k3, k4, k5, k6) != polymur_canon611(h)) {
+                    printf("avx512 block test failed for %zu blocks, seed %" PRIu64 "\n", 8 * s, seed);
+                    return 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+#endif
+
+static uint64_t hash_streaming(const uint8_t* buf, size_t len, size_t chunk, const PolymurHashParams* p, uint64_t tweak) {
+    PolymurHashState st;
+    polymur_hash_init(&st, p, tweak);
+    for (size_t i = 0; i < len; i += chunk) {
+        polymur_hash_update(&st, buf + i, len - i < chunk ? len - i : chunk);
+    }
+    return polymur_hash_finalize(&st);
+}
+
+static int test_init_params(void) {
+    PolymurHashParams a, b;
+    for (uint64_t i = 0; i < 20000; ++i) {
+        uint64_t k_seed = polymur_mix(i), s_seed = polymur_mix(~i);
+        polymur_init_params(&a, k_seed, s_seed);
+        polymur_init_params_fast(&b, k_seed, s_seed);
+        if (memcmp(&a, &b, sizeof(a)) != 0) {
+            printf("fast init test failed for seeds 0x%016" PRIx64 " 0x%016" PRIx64 "\n", k_seed, s_seed);
+            return 1;
+        }
+    }
+
+    static PolymurHashParams many[1001];
+    static const size_t counts[] = {0, 1, 3, 1000};
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+        many[counts[c]].s = 42; // Must not be written.
+        polymur_init_params_many(many, counts[c], 1000 * c);
+        for (size_t i = 0; i < counts[c]; ++i) {
+            polymur_init_params_from_seed(&a, 1000 * c + i);
+            if (memcmp(&a, &many[i], sizeof(a)) != 0) {
+                printf("batch init test failed for seed %zu of %zu\n", i, counts[c]);
+                return 1;
+            }
+        }
+        if (many[counts[c]].s != 42) {
+            printf("batch init test wrote past %zu params\n", counts[c]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int test_streaming(const PolymurHashParams* p, uint64_t tweak) {
+    for (int i = 0; POLYMUR_TEST_STRINGS[i]; ++i) {
+        const char* s = POLYMUR_TEST_STRINGS[i];
+        size_t len = strlen(s);
+        for (size_t chunk = 1; chunk <= len + 1; ++chunk) {
+            uint64_t h = hash_streaming((const uint8_t*) s, len, chunk, p, tweak);
+            if (h != POLYMUR_REFERENCE_VALUES[i]) {
+                printf("streaming test failed for \"%s\" with chunk size %zu\n", s, chunk);
+                return 1;
+            }
+        }
+    }
+
+    static uint8_t buf[1024];
+    static const size_t chunks[] = {1, 3, 7, 48, 49, 50, 98, 99, 500};
+    fill_test_data(buf, sizeof(buf), 1);
+    for (size_t len = 0; len <= sizeof(buf); ++len) {
+        uint64_t expected = polymur_hash(buf, len, p, tweak);
+        for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); ++c) {
+            if (hash_streaming(buf, len, chunks[c], p, tweak) != expected) {
+                printf("streaming test failed for length %zu with chunk size %zu\n", len, chunks[c]);
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int test_batch(const PolymurHashParams* p, uint64_t tweak) {
+    static uint8_t buf[4096];
+    static const uint8_t* keys[1000];
+    static size_t lens[1000];
+    static uint64_t out[1000];
+    fill_test_data(buf, sizeof(buf), 3);
+    for (size_t i = 0; i < 1000; ++i) {
+        lens[i] = polymur_mix(i) % 200;
+        keys[i] = buf + polymur_mix(i + 1000) % (sizeof(buf) - lens[i]);
+    }
+
+    static const size_t counts[] = {0, 1, 5, 63, 64, 65, 1000};
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+        polymur_hash_batch(keys, lens, counts[c], p, tweak, out);
+        for (size_t i = 0; i < counts[c]; ++i) {
+            if (out[i] != polymur_hash(keys[i], lens[i], p, tweak)) {
+                printf("batch test failed for key %zu of length %zu in batch of %zu\n", i, lens[i], counts[c]);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int test_int_arrays(const PolymurHashParams* p, uint64_t tweak) {
+    uint64_t k64[1000];
+    uint32_t k32[1000];
+    uint64_t out[1000];
+    for (size_t i = 0; i < 1000; ++i) {
+        k64[i] = i < 64 ? 1ULL << i : polymur_mix(i);
+        k32[i] = (uint32_t) k64[i] ^ (uint32_t) (k64[i] >> 32);
+    }
+
+    polymur_hash_u64_array(k64, 999, p, tweak, out);
+    for (size_t i = 0; i < 999; ++i) {
+        if (out[i] != polymur_hash((const uint8_t*) &k64[i], 8, p, tweak)) {
+            printf("u64 array test failed for 0x%016" PRIx64 "\n", k64[i]);
+            return 1;
+        }
+    }
+
+    polymur_hash_u32_array(k32, 999, p, tweak, out);
+    for (size_t i = 0; i < 999; ++i) {
+        if (out[i] != polymur_hash((const uint8_t*) &k32[i], 4, p, tweak)) {
+            printf("u32 array test failed for 0x%08" PRIx32 "\n", k32[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int test_columnar(const PolymurHashParams* p, uint64_t tweak) {
+    enum { ROWS = 300 };
+    static uint8_t data[ROWS * 100];
+    static int32_t off32[ROWS + 1];
+    static int64_t off64[ROWS + 1];
+    static uint8_t validity[(ROWS + 7) / 8];
+    static uint32_t sel[ROWS];
+    static uint64_t out32[ROWS], out64[ROWS];
+    fill_test_data(data, sizeof(data), 4);
+    off32[0] = off64[0] = 0;
+    for (size_t i = 0; i < ROWS; ++i) {
+        off32[i + 1] = off32[i] + (int32_t) (polymur_mix(i) % 100);
+        off64[i + 1] = off32[i + 1];
+        if (polymur_mix(i + ROWS) % 5 != 0) validity[i / 8] |= 1 << (i % 8);
+        sel[i] = (uint32_t) (polymur_mix(i + 2 * ROWS) % ROWS);
+    }
+
+    for (int variant = 0; variant < 4; ++variant) {
+        const uint8_t* v = (variant & 1) ? validity : NULL;
+        const uint32_t* s = (variant & 2) ? sel : NULL;
+        polymur_hash_column32(data, off32, v, s, ROWS, p, tweak, out32);
+        polymur_hash_column64(data, off64, v, s, ROWS, p, tweak, out64);
+        for (size_t j = 0; j < ROWS; ++j) {
+            size_t row = s ? s[j] : j;
+            int valid = !v || ((v[row / 8] >> (row % 8)) & 1);
+            uint64_t expected = polymur_column_null_hash(p, tweak);
+            if (valid) expected = polymur_hash(data + off32[row], off32[row + 1] - off32[row], p, tweak);
+            if (out32[j] != expected || out64[j] != expected) {
+                printf("columnar test failed for row %zu in variant %d\n", row, variant);
+                return 1;
+            }
+        }
+
+        // Combining with a second column, the same data reversed.
+        polymur_combine_column32(data, off32, v, s, ROWS, p, out32);
+        for (size_t j = 0; j < ROWS; ++j) {
+            size_t row = s ? s[j] : j;
+            int valid = !v || ((v[row / 8] >> (row % 8)) & 1);
+            uint64_t expected = polymur_column_null_hash(p, out64[j]);
+            if (valid) expected = polymur_hash(data + off32[row], off32[row + 1] - off32[row], p, out64[j]);
+            if (out32[j] != expected) {
+                printf("columnar combine test failed for row %zu in variant %d\n", row, variant);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Runs the tasks in reverse, to catch any dependence on the order.
+static void reverse_executor(void* ctx, void (*task)(void* arg, size_t i), void* arg, size_t ntasks) {
+    (void) ctx;
+    while (ntasks--) task(arg, ntasks);
+}
+
+static int test_parallel(const PolymurHashParams* p, uint64_t tweak) {
+    // Past 5000 bytes segments get long enough for the AVX-512 block loop.
+    static uint8_t buf[40000];
+    fill_test_data(buf, sizeof(buf), 6);
+    for (size_t len = 0; len <= sizeof(buf); len += len < 5000 ? 1 : 997) {
+        uint64_t expected = polymur_hash(buf, len, p, tweak);
+        for (size_t nseg = 1; nseg <= 9; ++nseg) {
+            if (polymur_hash_parallel(buf, len, p, tweak, nseg, reverse_executor, NULL) != expected) {
+                printf("parallel test failed for length %zu with %zu segments\n", len, nseg);
+                return 1;
+            }
+        }
+        if (polymur_hash_parallel(buf, len, p, tweak, 1000, NULL, NULL) != expected) {
+            printf("parallel test failed for length %zu with maximum segments\n", len);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int test_digest(const PolymurHashParams* p, uint64_t tweak) {
+    // Past 40 blocks digests get long enough for the AVX-512 block loop.
+    static uint8_t buf[49 * 400 + 49];
+    static uint8_t patched[sizeof(buf)];
+    fill_test_data(buf, sizeof(buf), 7);
+    for (size_t nblocks = 0; nblocks <= 400; nblocks += nblocks < 40 ? 1 : 41) {
+        for (size_t tail_len = nblocks ? 1 : 0; tail_len <= 49; tail_len += 6) {
+            size_t len = 49 * nblocks + tail_len;
+            uint64_t expected = polymur_hash(buf, len, p, tweak);
+
+            // Concatenate digests of two-way splits, all of them for short inputs.
+            for (size_t split = 0; split <= nblocks; split += nblocks <= 40 ? 1 : 13) {
+                PolymurDigest a, b, d;
+                uint64_t h;
+                polymur_digest_blocks(&a, buf, split, p);
+                polymur_digest_blocks(&b, buf + 49 * split, nblocks - split, p);
+                d = polymur_concat(p, a, b);
+                if (!polymur_digest_finalize(&d, buf + 49 * nblocks, tail_len, p, tweak, &h) || h != expected) {
+                    printf("digest test failed for length %zu split at block %zu\n", len, split);
+                    return 1;
+                }
+            }
+
+            // Overwrite a range of blocks and patch the digest.
+            if (nblocks < 3) continue;
+            size_t first = nblocks / 3, count = nblocks / 2;
+            PolymurDigest d;
+            uint64_t h;
+            memcpy(patched, buf, len);
+            fill_test_data(patched + 49 * first, 49 * count, nblocks);
+            polymur_digest_blocks(&d, buf, nblocks, p);
+            if (!polymur_digest_patch(&d, first, buf + 49 * first, patched + 49 * first, count, p)
+                || !polymur_digest_finalize(&d, patched + 49 * nblocks, tail_len, p, tweak, &h)
+                || h != polymur_hash(patched, len, p, tweak)) {
+                printf("digest patch test failed for length %zu\n", len);
+                return 1;
+            }
+
+            // Ranges past the end of the digest are rejected.
+            PolymurDigest e = d;
+            if (polymur_digest_patch(&e, nblocks - count + 1, buf, patched, count, p)
+                || polymur_digest_patch(&e, nblocks + 1, buf, patched, 0, p)
+                || e.h != d.h || e.nblocks != d.nblocks) {
+                printf("digest patch range test failed for length %zu\n", len);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int test_hash128(const PolymurHashParams128* p, uint64_t tweak) {
+    for (int i = 0; POLYMUR_TEST_STRINGS[i]; ++i) {
+        const char* s = POLYMUR_TEST_STRINGS[i];
+        PolymurHash128 h = polymur_hash128((const uint8_t*) s, strlen(s), p, tweak);
+        if (h.lo != POLYMUR_REFERENCE_VALUES[i] || h.hi != POLYMUR_REFERENCE_VALUES128_HI[i]) {
+            printf("128-bit reference test failed for \"%s\"\n", s);
+            printf("expected 0x%016" PRIx64 "%016" PRIx64 " got 0x%016" PRIx64 "%016" PRIx64 "\n",
+                   POLYMUR_REFERENCE_VALUES128_HI[i], POLYMUR_REFERENCE_VALUES[i], h.hi, h.lo);
+            return 1;
+        }
+    }
+
+    // Past 4096 bytes hash128 may take the AVX-512 path.
+    static uint8_t buf[6000];
+    fill_test_data(buf, sizeof(buf), 9);
+    for (size_t len = 0; len <= 5900; len += len < 500 ? 1 : 97) {
+        PolymurHash128 h = polymur_hash128(buf + len % 7, len, p, tweak + len);
+        if (h.lo != polymur_hash(buf + len % 7, len, &p->a, tweak + len) ||
+            h.hi != polymur_hash(buf + len % 7, len, &p->b, tweak + len)) {
+            printf("128-bit test failed for length %zu\n", len);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Finds the chunk ends for data the slow way, recomputing the window hash at
+// every position. Returns the number of chunks, including a final partial one.
+static size_t reference_cuts(const PolymurRoller* r, const uint8_t* data, size_t len, size_t* ends) {
+    size_t n = 0, start = 0;
+    for (size_t i = 0; i < len; ++i) {
+        uint64_t h = 0;
+        for (size_t d = 0; d < r->window && d <= i; ++d) {
+            h += r->gear[data[i - d]] << (64 - r->window + d);
+        }
+        size_t chunk_len = i + 1 - start;
+        uint64_t top_mask = r->mask << (64 - r->window);
+        if ((chunk_len >= r->min_size && !(h & top_mask)) || chunk_len == r->max_size) {
+            ends[n++] = start = i + 1;
+        }
+    }
+    if (start < len) ends[n++] = len;
+    return n;
+}
+
+// Chunks data, feeding it in pieces of random length up to max_piece, and
+// checks the chunks against the expected ends and polymur_hash.
+static int check_chunks(PolymurRoller* r, const uint8_t* data, size_t len, size_t max_piece,
+                        const size_t* ends, size_t nends, const PolymurHashParams* p, uint64_t tweak) {
+    size_t pos = 0, start = 0, n = 0;
+    uint64_t h;
+    for (uint64_t i = 0; pos < len; ++i) {
+        size_t piece = 1 + polymur_mix(i + max_piece) % max_piece;
+        if (piece > len - pos) piece = len - pos;
+        size_t used;
+        const uint8_t* buf = data + pos;
+        pos += piece;
+        while ((used = polymur_roller_update(r, buf, piece, &h))) {
+            size_t end = buf + used - data;
+            if (n >= nends || end != ends[n] || h != polymur_hash(data + start, end - start, p, tweak)) return 1;
+            start = end;
+            buf += used;
+            piece -= used;
+            ++n;
+        }
+    }
+    size_t final_len = polymur_roller_finish(r, &h);
+    if (final_len != len - start) return 1;
+    if (final_len && (n >= nends || h != polymur_hash(data + start, final_len, p, tweak))) return 1;
+    return n + (final_len > 0) != nends;
+}
+
+static int test_roller(const PolymurHashParams* p, uint64_t tweak) {
+    static uint8_t data[1 << 18];
+    static size_t ends[1 << 18], shifted_ends[1 << 18];
+    static const size_t windows[] = {1, 16, 48, 64};
+    static const size_t pieces[] = {1, 7, 100, 5000, 1 << 18};
+    fill_test_data(data, sizeof(data), 3);
+    PolymurRoller r;
+
+    for (size_t wi = 0; wi < sizeof(windows) / sizeof(windows[0]); ++wi) {
+        polymur_roller_init(&r, p, tweak, windows[wi], (1 << 9) - 1, 100, 2000);
+        size_t nends = reference_cuts(&r, data, sizeof(data), ends);
+        for (size_t pi = 0; pi < sizeof(pieces) / sizeof(pieces[0]); ++pi) {
+            // Reuses the roller, which finish resets.
+            if (check_chunks(&r, data, sizeof(data), pieces[pi], ends, nends, p, tweak)) {
+                printf("roller test failed for window %zu with pieces up to %zu\n", windows[wi], pieces[pi]);
+                return 1;
+            }
+        }
+    }
+
+    // Inserting a byte only moves the boundaries near it.
+    polymur_roller_init(&r, p, tweak, 48, (1 << 9) - 1, 100, 0);
+    size_t nends = reference_cuts(&r, data, sizeof(data), ends);
+    memmove(data + 1001, data + 1000, sizeof(data) - 1001);
+    data[1000] ^= 0x55;
+    size_t nshifted = reference_cuts(&r, data, sizeof(data), shifted_ends);
+    if (check_chunks(&r, data, sizeof(data), 5000, shifted_ends, nshifted, p, tweak)) {
+        printf("roller test failed after insertion\n");
+        return 1;
+    }
+    for (size_t i = 2; i < 100; ++i) {
+        if (shifted_ends[nshifted - i] != ends[nends - i] + 1) {
+            printf("roller boundaries did not resynchronize after an insertion\n");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int test_sketch(const PolymurHashParams* p, uint64_t tweak) {
+    // 100k keys of 4 to 40 bytes at 10 bits per key, queried with 100k others.
+    enum { N = 100000, NBLOCKS = N * 10 / 512 };
+    static uint8_t data[2 * N * 40];
+    static const uint8_t* keys[2 * N];
+    static size_t lens[2 * N];
+    static uint64_t words[NBLOCKS * 8], batch_words[NBLOCKS * 8];
+    static uint8_t found[2 * N];
+    fill_test_data(data, sizeof(data), 4);
+    for (size_t i = 0; i < 2 * N; ++i) {
+        keys[i] = data + 40 * i;
+        lens[i] = 4 + polymur_mix(i) % 37;
+    }
+
+    PolymurBloom b, bb;
+    polymur_bloom_init(&b, words, NBLOCKS, 7, p, tweak);
+    polymur_bloom_init(&bb, batch_words, NBLOCKS, 7, p, tweak);
+    for (size_t i = 0; i < N; ++i) polymur_bloom_insert(&b, keys[i], lens[i]);
+    polymur_bloom_insert_batch(&bb, keys, lens, N);
+    if (memcmp(words, batch_words, sizeof(words))) {
+        printf("bloom filter batch insert differs\n");
+        return 1;
+    }
+    polymur_bloom_query_batch(&b, keys, lens, 2 * N, found);
+    size_t false_positives = 0;
+    for (size_t i = 0; i < 2 * N; ++i) {
+        if (found[i] != polymur_bloom_query(&b, keys[i], lens[i])) {
+            printf("bloom filter batch query differs for key %zu\n", i);
+            return 1;
+        }
+        if (i < N && !found[i]) {
+            printf("bloom filter false negative for key %zu\n", i);
+            return 1;
+        }
+        if (i >= N) false_positives += found[i];
+    }
+    // An unblocked filter would have 0.82%, blocking adds a little.
+    double fpr = (double) false_positives / N;
+    if (fpr > 0.015) {
+        printf("bloom filter false positive rate %.4f too high\n", fpr);
+        return 1;
+    }
+
+    // Key i is added i % 10 + 1 times, with one batch add of counts.
+    enum { CM_BLOCKS = 16384 };
+    static uint32_t counters[CM_BLOCKS * 16], batch_counters[CM_BLOCKS * 16];
+    static uint32_t counts[N], est[N];
+    PolymurCountMin cm, bcm;
+    polymur_cm_init(&cm, counters, CM_BLOCKS, 4, p, tweak);
+    polymur_cm_init(&bcm, batch_counters, CM_BLOCKS, 4, p, tweak);
+    for (size_t i = 0; i < N; ++i) {
+        counts[i] = i % 10 + 1;
+        polymur_cm_add(&cm, keys[i], lens[i], counts[i]);
+    }
+    polymur_cm_add_batch(&bcm, keys, lens, counts, N);
+    if (memcmp(counters, batch_counters, sizeof(counters))) {
+        printf("count-min batch add differs\n");
+        return 1;
+    }
+    polymur_cm_estimate_batch(&cm, keys, lens, N, est);
+    double excess = 0;
+    for (size_t i = 0; i < N; ++i) {
+        if (est[i] != polymur_cm_estimate(&cm, keys[i], lens[i]) || est[i] < counts[i]) {
+            printf("count-min estimate wrong for key %zu\n", i);
+            return 1;
+        }
+        excess += est[i] - counts[i];
+    }
+    // Each counter receives 4 * 550k / 256k = 8.4 on average, the minimum of
+    // four should be well below that.
+    if (excess / N > 4) {
+        printf("count-min average overestimate %.1f too high\n", excess / N);
+        return 1;
+    }
+
+    // In a single block each key gets depth distinct counters, and keys spread
+    // over most of the C(16, 4) = 1820 possible sets.
+    static uint8_t seen_sets[1 << 16];
+    size_t nsets = 0;
+    for (size_t i = 0; i < 20000; ++i) {
+        uint32_t block[16] = {0};
+        polymur_cm_init(&cm, block, 1, 4, p, tweak);
+        polymur_cm_add(&cm, keys[i], lens[i], 1);
+        unsigned set = 0, nused = 0;
+        for (unsigned c = 0; c < 16; ++c) {
+            set |= (unsigned) (block[c] != 0) << c;
+            nused += block[c] != 0;
+        }
+        if (nused != 4) {
+            printf("count-min counters of key %zu are not distinct\n", i);
+            return 1;
+        }
+        nsets += !seen_sets[set];
+        seen_sets[set] = 1;
+    }
+    if (nsets < 1700) {
+        printf("count-min keys only use %zu distinct counter sets\n", nsets);
+        return 1;
+    }
+    return 0;
+}
+
+#ifdef POLYMUR_INSTRUMENT
+static int test_stats(const PolymurHashParams* p, uint64_t tweak) {
+    static uint8_t buf[200];
+    fill_test_data(buf, sizeof(buf), 3);
+    PolymurStats before, after;
+    uint64_t calls[POLYMUR_STATS_CLASSES] = {0}, bytes[POLYMUR_STATS_CLASSES] = {0};
+    polymur_stats_snapshot(&before);
+    for (int rep = 0; rep < 16; ++rep) {
+        for (size_t len = 0; len <= sizeof(buf); ++len) {
+            int c = len <= 7 ? 0 : len <= 49 ? 1 : 2;
+            polymur_hash(buf, len, p, tweak);
+            ++calls[c];
+            bytes[c] += len;
+        }
+    }
+    polymur_stats_snapshot(&after);
+    for (int c = 0; c < POLYMUR_STATS_CLASSES; ++c) {
+        if (after.calls[c] - before.calls[c] != calls[c] || after.bytes[c] - before.bytes[c] != bytes[c]) {
+            printf("stats test failed for length class %d\n", c);
+            return 1;
+        }
+        if (after.sampled_calls[c] > after.calls[c]) {
+            printf("stats test sampled more calls than made in length class %d\n", c);
+            return 1;
+        }
+    }
+    if (after.sampled_calls[2] == before.sampled_calls[2]) {
+        printf("stats test sampled no calls\n");
+        return 1;
+    }
+    return 0;
+}
+#endif
+
+#ifdef POLYMUR_HAS_IOVEC
+static int test_iov(const PolymurHashParams* p, uint64_t tweak) {
+    static uint8_t buf[512];
+    struct iovec iov[64];
+    fill_test_data(buf, sizeof(buf), 2);
+    for (size_t len = 0; len <= sizeof(buf); ++len) {
+        uint64_t expected = polymur_hash(buf, len, p, tweak);
+        for (uint64_t seed = 0; seed < 16; ++seed) {
+            // Cut into random fragments, including empty ones.
+            int n = 0;
+            size_t pos = 0;
+            while (pos < len && n < 63) {
+                size_t frag = polymur_mix(seed * 1000 + n) % 60;
+                if (frag > len - pos) frag = len - pos;
+                iov[n].iov_base = buf + pos;
+                iov[n].iov_len = frag;
+                pos += frag;
+                ++n;
+            }
+            iov[n].iov_base = buf + pos;
+            iov[n].iov_len = len - pos;
+            ++n;
+            if (polymur_hash_iov(iov, n, p, tweak) != expected) {
+                printf("iovec test failed for length %zu with %d fragments\n", len, n);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+#endif
+
 int main(int argc, char** argv) {
     PolymurHashParams p;
     polymur_init_params_from_seed(&p, 0xfedbca9876543210ULL);
     const uint64_t tweak = 0xabcdef0123456789ULL;
     
+    PolymurHashParams128 p128;
+    polymur_init_params128_from_seed(&p128, 0xfedbca9876543210ULL);
+
+    if (argc >= 2 && strcmp(argv[1], "gen128") == 0) {
+        for (int i = 0; POLYMUR_TEST_STRINGS[i]; ++i) {
+            const char* s = POLYMUR_TEST_STRINGS[i];
+            PolymurHash128 h = polymur_hash128((const uint8_t*) s, strlen(s), &p128, tweak);
+            printf("0x%016" PRIx64 " = \"%s\"\n", h.hi, s);
+        }
+        return 0;
+    }
+
     if (argc >= 2 && strcmp(argv[1], "gen") == 0) {
         for (int i = 0; POLYMUR_TEST_STRINGS[i]; ++i) {
             const char* s = POLYMUR_TEST_STRINGS[i];
@@ -159,6 +849,27 @@ int main(int argc, char** argv) {
             return 1;
         }
     }
+
+#ifdef POLYMUR_HAS_AVX512IFMA
+    if (test_avx512_blocks()) return 1;
+#endif
+    if (test_against_reference(&p, tweak)) return 1;
+    if (test_init_params()) return 1;
+    if (test_streaming(&p, tweak)) return 1;
+    if (test_batch(&p, tweak)) return 1;
+    if (test_int_arrays(&p, tweak)) return 1;
+    if (test_columnar(&p, tweak)) return 1;
+    if (test_parallel(&p, tweak)) return 1;
+    if (test_digest(&p, tweak)) return 1;
+    if (test_hash128(&p128, tweak)) return 1;
+    if (test_roller(&p, tweak)) return 1;
+    if (test_sketch(&p, tweak)) return 1;
+#ifdef POLYMUR_HAS_IOVEC
+    if (test_iov(&p, tweak)) return 1;
+#endif
+#ifdef POLYMUR_INSTRUMENT
+    if (test_stats(&p, tweak)) return 1;
+#endif
     
     return 0;
 }
@@ -0,0 +1,189 @@
+// Tests for polymur-hash.hpp, build with e.g. c++ -std=c++17 -O2 test.cpp.
+// This also checks that the C header compiles cleanly as C++, so warnings
+// are best made errors: c++ -std=c++17 -O2 -Wall -Wextra -Werror test.cpp.
+
+#include <cstdio>
+#include <cstring>
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "polymur-hash.hpp"
+#include "polymur-map.hpp"
+
+// Same parameters and reference values as test.c.
+constexpr polymur::Params P(0xfedbca9876543210ULL);
+constexpr uint64_t TWEAK = 0xabcdef0123456789ULL;
+
+static_assert(polymur::hash("", P, TWEAK) == 0x1a6ef9f9d6c576fbULL, "");
+static_assert(polymur::hash("vn5719", P, TWEAK) == 0xb16ce684b89df9c0ULL, "");
+static_assert(polymur::hash("oo70ed77jci4bgodhnyf37axrx4f8gf8qs94f4l9xi9h0jkdl2ozoi2p7q7qu1945l21dzj6rhvqearzrmblfo3ljjldj0m9fue",
+                            P, TWEAK) == 0x194fa4f68aab8e27ULL, "");
+
+static int test_params() {
+    PolymurHashParams c;
+    for (uint64_t seed = 0; seed < 1000; ++seed) {
+        polymur::Params p(seed);
+        polymur_init_params_from_seed(&c, seed);
+        if (std::memcmp(&c, &p.c, sizeof(c)) != 0) {
+            std::printf("params test failed for seed %llu\n", (unsigned long long) seed);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static uint8_t buf[512];
+
+template<size_t... Ns>
+static int test_fixed_lengths(const polymur::Params& p, uint64_t tweak, std::index_sequence<Ns...>) {
+    const size_t lens[] = {Ns...};
+    const uint64_t hashes[] = {polymur::hash<Ns>(buf + Ns % 7, p, tweak)...};
+    for (size_t i = 0; i < sizeof...(Ns); ++i) {
+        if (hashes[i] != polymur_hash(buf + lens[i] % 7, lens[i], &p.c, tweak)) {
+            std::printf("fixed length test failed for length %zu\n", lens[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int test_strings(const polymur::Params& p, uint64_t tweak) {
+    for (size_t len = 0; len <= 400; ++len) {
+        std::string_view s(reinterpret_cast<const char*>(buf), len);
+        uint64_t expected = polymur_hash(buf, len, &p.c, tweak);
+        if (polymur::hash(s, p, tweak) != expected || polymur::detail::mix(polymur::detail::poly611(s.data(), len, p, tweak)) + p.c.s != expected) {
+            std::printf("string test failed for length %zu\n", len);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// The integer array kernels, compiled as C++ to catch warnings from the
+// intrinsics headers inlined into them.
+static int test_int_arrays(const polymur::Params& p, uint64_t tweak) {
+    uint64_t k64[40], out[40];
+    uint32_t k32[40];
+    std::memcpy(k64, buf, sizeof(k64));
+    std::memcpy(k32, buf, sizeof(k32));
+    for (size_t n = 0; n <= 40; ++n) {
+        polymur_hash_u64_array(k64, n, &p.c, tweak, out);
+        for (size_t i = 0; i < n; ++i) {
+            if (out[i] != polymur_hash(reinterpret_cast<const uint8_t*>(&k64[i]), 8, &p.c, tweak)) {
+                std::printf("u64 array test failed for key %zu of %zu\n", i, n);
+                return 1;
+            }
+        }
+        polymur_hash_u32_array(k32, n, &p.c, tweak, out);
+        for (size_t i = 0; i < n; ++i) {
+            if (out[i] != polymur_hash(reinterpret_cast<const uint8_t*>(&k32[i]), 4, &p.c, tweak)) {
+                std::printf("u32 array test failed for key %zu of %zu\n", i, n);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int test_switch(const char* cmd) {
+    switch (polymur::hash(cmd, P)) {
+        case polymur::hash("get", P): return 1;
+        case polymur::hash("put", P): return 2;
+        case polymur::hash("delete", P): return 3;
+        default: return 0;
+    }
+}
+
+static int test_hasher() {
+    polymur::Hasher a, b;
+    std::string s = "polymur";
+    if (a(s) != a(std::string_view(s)) || a(s) != a("polymur") || a(s) == b(s)) {
+        std::printf("hasher test failed\n");
+        return 1;
+    }
+    uint64_t x = 42;
+    if (a(x) != polymur_hash(reinterpret_cast<const uint8_t*>(&x), 8, &a.params->c, a.tweak)) {
+        std::printf("hasher test failed for integers\n");
+        return 1;
+    }
+    return 0;
+}
+
+static int test_flat_map() {
+    // Random operations mirrored in std::unordered_map.
+    polymur::FlatMap<uint64_t, uint64_t> map;
+    std::unordered_map<uint64_t, uint64_t> ref;
+    for (uint64_t i = 0; i < 200000; ++i) {
+        uint64_t r = polymur_mix(i);
+        uint64_t key = r % 5000;
+        switch ((r >> 32) % 4) {
+            case 0:
+            case 1: map[key] = i; ref[key] = i; break;
+            case 2:
+                if (map.erase(key) != ref.erase(key)) {
+                    std::printf("flat map test failed erasing %llu\n", (unsigned long long) key);
+                    return 1;
+                }
+                break;
+            case 3: {
+                auto it = map.find(key);
+                auto rit = ref.find(key);
+                if ((it == map.end()) != (rit == ref.end()) || (it != map.end() && it->second != rit->second)) {
+                    std::printf("flat map test failed finding %llu\n", (unsigned long long) key);
+                    return 1;
+                }
+            }
+        }
+        if (map.size() != ref.size()) {
+            std::printf("flat map test failed, size %zu instead of %zu\n", map.size(), ref.size());
+            return 1;
+        }
+    }
+
+    size_t n = 0;
+    for (const auto& kv : map) n += ref.count(kv.first) && ref[kv.first] == kv.second;
+    polymur::FlatMap<uint64_t, uint64_t> copy = map;
+    polymur::FlatMap<uint64_t, uint64_t> moved = std::move(copy);
+    if (n != ref.size() || moved.size() != ref.size() || !moved.contains(ref.begin()->first)) {
+        std::printf("flat map test failed for iteration or copies\n");
+        return 1;
+    }
+
+    // Transparent lookup of string keys.
+    polymur::FlatMap<std::string, int> strings;
+    strings["abc"] = 1;
+    strings.try_emplace(std::string(100, 'x'), 2);
+    if (!strings.contains("abc") || strings.find(std::string_view("abc"))->second != 1 ||
+        strings.find(std::string(100, 'x'))->second != 2 || strings.contains("abd")) {
+        std::printf("flat map test failed for strings\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    for (size_t i = 0; i < sizeof(buf); ++i) buf[i] = (uint8_t) polymur_mix(i);
+
+    if (test_params()) return 1;
+    if (test_fixed_lengths(P, TWEAK, std::make_index_sequence<200>())) return 1;
+    polymur::Params q(1, 2);
+    if (test_fixed_lengths(q, 0, std::make_index_sequence<200>())) return 1;
+    if (test_strings(P, TWEAK)) return 1;
+    if (test_int_arrays(P, TWEAK)) return 1;
+
+    std::array<char, 16> arr{};
+    std::memcpy(arr.data(), buf, 16);
+    if (polymur::hash_value(arr, P) != polymur_hash(buf, 16, &P.c, 0)) {
+        std::printf("hash_value test failed\n");
+        return 1;
+    }
+    if (test_hasher()) return 1;
+    if (test_flat_map()) return 1;
+    if (test_switch("get") != 1 || test_switch("put") != 2 || test_switch("delete") != 3 || test_switch("post") != 0) {
+        std::printf("switch test failed\n");
+        return 1;
+    }
+    return 0;
+}